@@ -0,0 +1,146 @@
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+
+#include "net_config.h"
+#include "layout.h"
+#include "verifier.h"
+
+/**
+ * ./layout_bench [--size S] [--layers L] [--scale F] [--nets F] [--save DIR] [--engine dfs|best-first] [--verify] [--route-threads N] [--route-batch B]
+ *                [--rng xoshiro|mt19937] [--cost-limit C]
+ *
+ * Fixed-seed workloads matching the levels table of case_gen.py:
+ * S x S x L dies with 1/15/75/150/300 nets, reporting throughput, per-phase time and search counters.
+ * --scale F: multiply the number of cases of every level by F (default 1)
+ * --nets F: multiply the number of nets of every level by F (default 1), dense dies for the reroute budget
+ * --save DIR: also write every case with saveResult to DIR (to include output in the profile)
+ * --engine dfs|best-first: search engine of every net (default dfs)
+ * --route-threads N --route-batch B: route the nets of every case on N threads, B at a time (see Layout::setRouteThreads)
+ * --rng xoshiro|mt19937: random engine (default xoshiro)
+ * --cost-limit C: cells a net may cost before it's abandoned (default: autoConfig's, 0: no limit, see Net_config::cost_limit)
+ * --verify: also check every case with a Verifier (reported as the verify phase)
+ */
+struct Bench_level{
+   int test_num;
+   float obs_ratio;
+   int net_num;
+   int pin_num;
+};
+
+int main(int argc, char *argv[]){
+   int size = 500, layers = 3;
+   float scale = 1.0, net_scale = 1.0;
+   long long cost_limit = -1;//autoConfig's
+   std::string save_dir;
+   Search_engine engine = DFS_ENGINE;
+   bool verify = false;
+   int route_threads = 1, route_batch = 0;
+   Random_engine rng = XOSHIRO_ENGINE;
+   for(int i = 1; i < argc; ++i){
+      std::string arg(argv[i]);
+      if(arg == "--size" && i + 1 < argc){
+         size = atoi(argv[++i]);
+      }else if(arg == "--layers" && i + 1 < argc){
+         layers = atoi(argv[++i]);
+      }else if(arg == "--scale" && i + 1 < argc){
+         scale = atof(argv[++i]);
+      }else if(arg == "--nets" && i + 1 < argc){
+         net_scale = atof(argv[++i]);
+      }else if(arg == "--cost-limit" && i + 1 < argc){
+         cost_limit = atoll(argv[++i]);
+      }else if(arg == "--save" && i + 1 < argc){
+         save_dir = argv[++i];
+      }else if(arg == "--engine" && i + 1 < argc){
+         std::string name(argv[++i]);
+         if(name != "dfs" && name != "best-first"){
+            std::cerr << "--engine must be dfs or best-first" << std::endl;
+            return 1;
+         }
+         engine = (name == "best-first") ? BEST_FIRST_ENGINE : DFS_ENGINE;
+      }else if(arg == "--route-threads" && i + 1 < argc){
+         route_threads = atoi(argv[++i]);
+      }else if(arg == "--route-batch" && i + 1 < argc){
+         route_batch = atoi(argv[++i]);
+      }else if(arg == "--rng" && i + 1 < argc){
+         std::string name(argv[++i]);
+         if(name != "xoshiro" && name != "mt19937"){
+            std::cerr << "--rng must be xoshiro or mt19937" << std::endl;
+            return 1;
+         }
+         rng = (name == "mt19937") ? MT19937_ENGINE : XOSHIRO_ENGINE;
+      }else if(arg == "--verify"){
+         verify = true;
+      }else{
+         std::cerr << "unknown argument " << arg << std::endl;
+         return 1;
+      }
+   }
+   const int min_obs_size = size * 0.05, max_obs_size = size * 0.5;
+   const std::vector<Bench_level> levels = {
+      {200, 0.50, 1, 4},
+      {40, 0.50, 15, 5},
+      {10, 0.25, 75, 5},
+      {6, 0.10, 150, 5},
+      {4, 0.05, 300, 5},
+   };
+
+   std::cout << "die " << size << "x" << size << "x" << layers << "\n";
+   Layout L(size, size, layers, 0, 0, rng);
+   L.setRouteThreads(route_threads, route_batch);
+   Verifier verifier(size, size, layers);
+   int illegal = 0;
+   for(size_t lv = 0; lv < levels.size(); ++lv){
+      const Bench_level & level = levels[lv];
+      const int test_num = std::max(1, (int)(level.test_num * scale));
+      const int obs_num = size * level.obs_ratio;
+      const int net_num = std::max(1, (int)(level.net_num * net_scale));
+      L.stats.clear();
+      std::ostringstream log;
+      auto beg = std::chrono::steady_clock::now();
+      for(int i = 0; i < test_num; ++i){
+         std::vector<std::pair<int, Net_config>> net_configs;
+         L.reset(i, caseSeed(0, lv, i, 0));
+         std::vector<int> obs_nums(layers, obs_num / layers);
+         for (int j = 0; j < (obs_num % layers); j++) obs_nums[j]++;
+         L.generateObstacles(obs_nums, std::vector<std::pair<int, int>>(layers, {min_obs_size, max_obs_size}));
+         L.autoConfig(net_configs, net_num, level.pin_num);
+         for(std::pair<int, Net_config> & c : net_configs){
+            c.second.engine = engine;
+            if(cost_limit >= 0) c.second.cost_limit = cost_limit;
+         }
+         L.generateNets(net_configs, log);
+         if(verify){
+            Phase_timer timer(L.stats.verify_time);
+            const Verify_result result = verifier.verify(L);
+            if(!result.legal()){
+               ++illegal;
+               result.print(std::cerr);
+            }
+         }
+         if(save_dir.size()){
+            const std::string save_name = save_dir + "/" + std::to_string(lv) + "_" + std::to_string(i) + ".txt";
+            if(!L.saveResult(save_name)){
+               std::cerr << "Cannot save " << save_name << "." << std::endl;
+               return 1;
+            }
+         }
+      }
+      const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - beg).count();
+      std::cout << "level_" << lv << ": " << test_num << " cases, " << net_num << " nets x " << level.pin_num << " pins, "
+         << std::fixed << std::setprecision(3) << elapsed << " s, "
+         << std::setprecision(1) << test_num / elapsed << " cases/s, " << L.stats.nets_created / elapsed << " nets/s, "
+         << std::setprecision(2) << (double)L.stats.search_calls / std::max(1LL, L.stats.search_successes) << " searches/success, "
+         << std::setprecision(1) << 1e6 * L.stats.search_time / std::max(1LL, L.stats.nets_created) << " us search/net\n";
+      std::cout.unsetf(std::ios::floatfield);
+      L.stats.print(std::cout);
+   }
+   if(illegal){
+      std::cerr << illegal << " illegal cases" << std::endl;
+      return 1;
+   }
+   return 0;
+}
@@ -0,0 +1,87 @@
+#ifndef _BITMATRIX_H_
+#define _BITMATRIX_H_
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "debugger.h"
+
+/**
+ * Dense bit matrix stored as one contiguous array of 64-bit words,
+ * every row padded to a whole number of words (stride).
+ * Runs of set bits are found word by word with ctz instead of bit by bit.
+ */
+class BitMatrix{
+public:
+   BitMatrix() : rows(0), cols(0), stride(0){}
+   BitMatrix(int _rows, int _cols){
+      resize(_rows, _cols);
+   }
+   void resize(int _rows, int _cols){
+      rows = _rows;
+      cols = std::max(_cols, 0);
+      stride = (cols + 63) / 64;
+      words.assign((size_t)rows * stride, 0);
+   }
+   void clear(){
+      std::fill(words.begin(), words.end(), 0);
+   }
+
+   inline bool get(int r, int c) const{
+      M_Assert(r >= 0 && r < rows && c >= 0 && c < cols, "out of range");
+      return (words[(size_t)r * stride + (c >> 6)] >> (c & 63)) & 1;
+   }
+   inline void set(int r, int c){
+      M_Assert(r >= 0 && r < rows && c >= 0 && c < cols, "out of range");
+      words[(size_t)r * stride + (c >> 6)] |= uint64_t(1) << (c & 63);
+   }
+   inline void reset(int r, int c){
+      M_Assert(r >= 0 && r < rows && c >= 0 && c < cols, "out of range");
+      words[(size_t)r * stride + (c >> 6)] &= ~(uint64_t(1) << (c & 63));
+   }
+   //clear bits [beg, end) of row r
+   void resetRange(int r, int beg, int end){
+      M_Assert(r >= 0 && r < rows && beg >= 0 && beg <= end && end <= cols, "out of range");
+      if(beg >= end) return;
+      uint64_t * row = &words[(size_t)r * stride];
+      const int wb = beg >> 6, we = (end - 1) >> 6;
+      const uint64_t mb = ~uint64_t(0) << (beg & 63);
+      const uint64_t me = ~uint64_t(0) >> (63 - ((end - 1) & 63));
+      if(wb == we){
+         row[wb] &= ~(mb & me);
+         return;
+      }
+      row[wb] &= ~mb;
+      for(int w = wb + 1; w < we; ++w){
+         row[w] = 0;
+      }
+      row[we] &= ~me;
+   }
+   //first set bit of row r at or after c, cols if none
+   inline int nextSet(int r, int c) const{
+      return scan(r, c, 0);
+   }
+   //first clear bit of row r at or after c, cols if none
+   inline int nextClear(int r, int c) const{
+      return scan(r, c, ~uint64_t(0));
+   }
+
+   int rows;
+   int cols;
+private:
+   inline int scan(int r, int c, uint64_t flip) const{
+      if(c >= cols) return cols;
+      const uint64_t * row = &words[(size_t)r * stride];
+      int w = c >> 6;
+      uint64_t bits = (row[w] ^ flip) & (~uint64_t(0) << (c & 63));
+      while(!bits){
+         if(++w >= stride) return cols;
+         bits = row[w] ^ flip;
+      }
+      return std::min(cols, (w << 6) + __builtin_ctzll(bits));
+   }
+
+   int stride;//words per row
+   std::vector<uint64_t> words;
+};
+
+#endif
@@ -4,6 +4,7 @@ import pickle
 import subprocess
 import shutil
 import glob
+import random
 import matplotlib.pyplot as plt
 from matplotlib.patches import Rectangle
 
@@ -237,6 +238,58 @@ def format(fin_name, fout_name):
 
 MAIN = "main"
 SUFFIX = ""
+SEED = 0
+EVAL_LEVEL = 100  # seed level of eval / test cases, keeps them apart from training levels
+TEST_LEVEL = 200
+SHARD = None  # (k, N): only generate the cases i % N == k
+MERGE = False  # only check the shards and write config files
+INCREMENTAL = False  # training levels from level_2 on continue the cases of the level before
+
+
+def run_level(lv_raw_dir, lv_dir, level, id_offset, argv, snapshots=""):
+    """
+    generate one level (or its shard) with the generator, then visualize case 0 once the level is complete,
+    snapshots: extra --snapshot-out / --snapshot-in options
+    """
+    os.makedirs(lv_raw_dir, exist_ok=True)
+    os.makedirs(lv_dir, exist_ok=True)
+    if not MERGE:
+        # raw cases and formatted id_*.txt are both written by the generator,
+        # rerunning skips the cases already listed in its manifest
+        shard = f"--shard {SHARD[0]}/{SHARD[1]} " if SHARD else ""
+        assert 0 == subprocess.call(
+            f"./{MAIN} {shard}--seed {SEED} --level {level} --env-dir {lv_dir} --id-offset {id_offset} {snapshots}"
+            f"{lv_raw_dir} {' '.join([str(arg) for arg in argv])}",
+            shell=True,
+        )
+    if SHARD is None or MERGE:
+        check_manifests(lv_raw_dir, argv[0])
+        visual(f"{lv_raw_dir}/0.txt")
+
+
+def check_manifests(lv_raw_dir, test_num):
+    """
+    make sure the shards of a level were generated with the same seed / parameters and cover every case
+    """
+    headers = {}
+    done = set()
+    for path in glob.glob(f"{lv_raw_dir}/manifest*.txt"):
+        with open(path, "r") as f:
+            header = []
+            for line in f:
+                if not line.endswith("\n"):  # cut by a crash
+                    continue
+                key, *values = line.split()
+                if key == "done":
+                    done.add(int(values[0]))
+                elif key != "shard":
+                    header.append(line)
+            headers[path] = "".join(header)
+    assert len(set(headers.values())) == 1, f"{lv_raw_dir}: shards of different runs {list(headers)}"
+    missing = sorted(set(range(test_num)) - done)
+    assert not missing, (
+        f"{lv_raw_dir}: {len(missing)} cases missing (e.g. {missing[:10]}), rerun the shards they belong to (i % N)"
+    )
 
 
 def gen_train(size, layer, argvs):
@@ -245,34 +298,30 @@ def gen_train(size, layer, argvs):
     """
     index = 10000
     dir = f"train_{size}x{size}x{layer}{SUFFIX}"
-    os.mkdir(dir)
     raw_dir = f"{dir}/raw"
-    os.mkdir(raw_dir)
     for lv, argv in enumerate(argvs):
-        lv_raw_dir = f"{raw_dir}/level_{lv}"
-        os.mkdir(lv_raw_dir)
-        assert 0 == subprocess.call(
-            f"./{MAIN} {lv_raw_dir} {' '.join([str(arg) for arg in argv])}",
-            shell=True,
+        snapshots = ""
+        if INCREMENTAL and 1 <= lv < len(argvs) - 1:  # level_0 (single net) stays apart
+            snapshots += f"--snapshot-out {raw_dir}/level_{lv}/snapshots "
+        if INCREMENTAL and lv >= 2:
+            # case i restores case i of the level before: its obstacles and nets, plus the missing nets
+            prev = argvs[lv - 1]
+            assert argv[0] <= prev[0] and argv[-1] == prev[-1] and argv[-2] > prev[-2], "levels can't be derived"
+            snapshots += f"--snapshot-in {raw_dir}/level_{lv - 1}/snapshots "
+            argv = argv[:-2] + (argv[-2] - prev[-2], argv[-1])
+        run_level(f"{raw_dir}/level_{lv}", f"{dir}/level_{lv}", lv, (lv + 1) * index, argv, snapshots)
+    if SHARD is None or MERGE:
+        gen_cases(
+            dir=dir,
+            width=size,
+            height=size,
+            layer=layer,
+            level_num=len(argvs),
+            indices=[(i + 1) * index for i in range(len(argvs))],
+            types=[0 for _ in range(len(argvs))],
+            trainings=[argvs[0][-2] == 1] + [False] * (len(argvs) - 1),  # net_num == 1
+            numbers=[i[0] for i in argvs],  # test_num
         )
-        lv_dir = f"{dir}/level_{lv}"
-        os.mkdir(lv_dir)
-        for fin in os.listdir(lv_raw_dir):
-            if 0 == int(fin[:-4]):
-                visual(f"{lv_raw_dir}/{fin}")
-            fout = f"id_{(lv + 1) * index + int(fin[:-4])}.txt"
-            format(f"{lv_raw_dir}/{fin}", f"{lv_dir}/{fout}")
-    gen_cases(
-        dir=dir,
-        width=size,
-        height=size,
-        layer=layer,
-        level_num=len(argvs),
-        indices=[(i + 1) * index for i in range(len(argvs))],
-        types=[0 for _ in range(len(argvs))],
-        trainings=[argvs[0][-2] == 1] + [False] * (len(argvs) - 1),  # net_num == 1
-        numbers=[i[0] for i in argvs],  # test_num
-    )
 
 
 def gen_eval(size, layer, argv):
@@ -280,33 +329,19 @@ def gen_eval(size, layer, argv):
     generate cases for evaluating set
     """
     dir = f"eval_{size}x{size}x{layer}{SUFFIX}"
-    os.mkdir(dir)
-    raw_dir = f"{dir}/raw"
-    os.mkdir(raw_dir)
-    lv_raw_dir = f"{raw_dir}/level_0"
-    os.mkdir(lv_raw_dir)
-    assert 0 == subprocess.call(
-        f"./{MAIN} {lv_raw_dir} {' '.join([str(arg) for arg in argv])}",
-        shell=True,
-    )
-    lv_dir = f"{dir}/level_0"
-    os.mkdir(lv_dir)
-    for fin in os.listdir(lv_raw_dir):
-        if 0 == int(fin[:-4]):
-            visual(f"{lv_raw_dir}/{fin}")
-        fout = f"id_{int(fin[:-4])}.txt"
-        format(f"{lv_raw_dir}/{fin}", f"{lv_dir}/{fout}")
-    gen_cases(
-        dir=dir,
-        width=size,
-        height=size,
-        layer=layer,
-        level_num=1,
-        indices=[0],
-        types=[0],
-        trainings=[False],
-        numbers=[argv[0]],  # test_num
-    )
+    run_level(f"{dir}/raw/level_0", f"{dir}/level_0", EVAL_LEVEL, 0, argv)
+    if SHARD is None or MERGE:
+        gen_cases(
+            dir=dir,
+            width=size,
+            height=size,
+            layer=layer,
+            level_num=1,
+            indices=[0],
+            types=[0],
+            trainings=[False],
+            numbers=[argv[0]],  # test_num
+        )
 
 
 def gen_test(size, layer, argv):
@@ -314,33 +349,19 @@ def gen_test(size, layer, argv):
     copy evaluating cases as testing set
     """
     dir = f"test_{size}x{size}x{layer}{SUFFIX}"
-    os.mkdir(dir)
-    raw_dir = f"{dir}/raw"
-    os.mkdir(raw_dir)
-    lv_raw_dir = f"{raw_dir}/level_0"
-    os.mkdir(lv_raw_dir)
-    assert 0 == subprocess.call(
-        f"./{MAIN} {lv_raw_dir} {' '.join([str(arg) for arg in argv])}",
-        shell=True,
-    )
-    lv_dir = f"{dir}/level_0"
-    os.mkdir(lv_dir)
-    for fin in os.listdir(lv_raw_dir):
-        if 0 == int(fin[:-4]):
-            visual(f"{lv_raw_dir}/{fin}")
-        fout = f"id_{int(fin[:-4])}.txt"
-        format(f"{lv_raw_dir}/{fin}", f"{lv_dir}/{fout}")
-    gen_cases(
-        dir=dir,
-        width=size,
-        height=size,
-        layer=layer,
-        level_num=1,
-        indices=[0],
-        types=[1],
-        trainings=[False],
-        numbers=[argv[0]],  # test_num
-    )
+    run_level(f"{dir}/raw/level_0", f"{dir}/level_0", TEST_LEVEL, 0, argv)
+    if SHARD is None or MERGE:
+        gen_cases(
+            dir=dir,
+            width=size,
+            height=size,
+            layer=layer,
+            level_num=1,
+            indices=[0],
+            types=[1],
+            trainings=[False],
+            numbers=[argv[0]],  # test_num
+        )
 
 
 if __name__ == "__main__":
@@ -349,9 +370,22 @@ if __name__ == "__main__":
     parser.add_argument("--suffix", default="", type=str)
     parser.add_argument("--size", default=500, type=int)
     parser.add_argument("--layer", default=3, type=int)
+    parser.add_argument("--seed", default=None, type=int)  # same seed, same data set
+    parser.add_argument("--shard", default=None, type=str)  # K/N
+    parser.add_argument("--merge", action="store_true")  # after every shard finished
+    parser.add_argument("--incremental", action="store_true")  # derive each training level from the one before
     args = parser.parse_args()
     MAIN = args.main
     SUFFIX = args.suffix
+    if args.shard is not None:
+        SHARD = tuple(int(v) for v in args.shard.split("/"))
+        assert len(SHARD) == 2 and 0 <= SHARD[0] < SHARD[1], "--shard must be K/N with 0 <= K < N"
+    MERGE = args.merge
+    INCREMENTAL = args.incremental
+    assert not (SHARD and MERGE), "--merge runs once after every --shard"
+    assert args.seed is not None or not (SHARD or MERGE), "shards must share --seed"
+    SEED = args.seed if args.seed is not None else random.randrange(2**63)
+    print(f"seed {SEED}")
     s = args.size
     l = args.layer
     min_obs_size, max_obs_size = int(s * 0.05), int(s * 0.5)
@@ -0,0 +1,184 @@
+#include "case_reader.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+CaseReader::CaseReader() : data(nullptr), size(0), cur(nullptr), end(nullptr){
+}
+
+CaseReader::~CaseReader(){
+   close();
+}
+
+void CaseReader::close(){
+   if(data != nullptr){
+      munmap(data, size);
+      data = nullptr;
+   }
+   size = 0;
+   cur = end = nullptr;
+}
+
+bool CaseReader::fail(const std::string & what){
+   message = filename + ":" + std::to_string(std::count(static_cast<const char *>(data), cur, '\n') + 1) + ": " + what;
+   return false;
+}
+
+bool CaseReader::open(const std::string & _filename){
+   close();
+   filename = _filename;
+   message.clear();
+   const int fd = ::open(filename.c_str(), O_RDONLY);
+   struct stat st;
+   if(fd < 0 || fstat(fd, &st) != 0 || st.st_size == 0){
+      if(fd >= 0) ::close(fd);
+      message = filename + ": cannot read";
+      return false;
+   }
+   size = st.st_size;
+   void * map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+   ::close(fd);
+   if(map == MAP_FAILED){
+      size = 0;
+      message = filename + ": cannot map";
+      return false;
+   }
+   madvise(map, size, MADV_SEQUENTIAL);
+   data = static_cast<char *>(map);
+   cur = data;
+   end = data + size;
+
+   int values[3];
+   if(!line("Width", values, 2)) return fail("expected Width 0 <width>");
+   head.width = values[1];
+   if(!line("Height", values, 2)) return fail("expected Height 0 <height>");
+   head.height = values[1];
+   if(!line("total_WL", values, 1)) return fail("expected total_WL <wl>");
+   head.total_wl = values[0];
+   if(!line("total_via", values, 1)) return fail("expected total_via <vias>");
+   head.total_via = values[0];
+   if(!line("Layer", values, 1)) return fail("expected Layer <layers>");
+   head.layers = values[0];
+   if(head.width <= 0 || head.height <= 0 || head.layers <= 0) return fail("empty die");
+   for(int z = 0; z < head.layers; ++z){//track<z> <start> <spacing> <direction>, implied by the layer
+      skipBlank();
+      if(end - cur < 5 || memcmp(cur, "track", 5) != 0) return fail("expected track" + std::to_string(z));
+      cur = std::find(cur, end, '\n');
+   }
+   return true;
+}
+
+void CaseReader::skipBlank(){
+   while(cur < end && (*cur == ' ' || *cur == '\t' || *cur == '\r' || *cur == '\n')) ++cur;
+}
+
+bool CaseReader::peek(const char * key){
+   skipBlank();
+   const size_t len = strlen(key);
+   return (size_t)(end - cur) >= len && memcmp(cur, key, len) == 0 &&
+      (cur + len == end || cur[len] == ' ' || cur[len] == '\t' || cur[len] == '\r' || cur[len] == '\n');
+}
+
+bool CaseReader::line(const char * key, int * values, int n){
+   if(!peek(key)) return false;
+   cur += strlen(key);
+   return row(values, n) == n;
+}
+
+int CaseReader::row(int * values, int n){
+   int count = 0;
+   for(;;){
+      while(cur < end && (*cur == ' ' || *cur == '\t' || *cur == '\r')) ++cur;
+      if(cur == end || *cur == '\n') return count;
+      const bool negative = (*cur == '-');
+      if(negative) ++cur;
+      if(cur == end || *cur < '0' || *cur > '9' || count == n) return -1;
+      long long v = 0;
+      for(; cur < end && *cur >= '0' && *cur <= '9'; ++cur){
+         v = v * 10 + (*cur - '0');
+         if(v > INT_MAX) return -1;
+      }
+      values[count++] = negative ? -v : v;
+   }
+}
+
+bool CaseReader::load(Layout & L){
+   if(data == nullptr) return false;
+   if(L.getWidth() != head.width || L.getHeight() != head.height || L.getLayers() != head.layers){
+      return fail("die differs from the layout");
+   }
+   const int width = head.width, height = head.height, layers = head.layers;
+   auto inDie = [&](int x, int y, int z){
+      return x >= 0 && x < width && y >= 0 && y < height && z >= 0 && z < layers;
+   };
+   //a box of cells [x1, x2) x [y1, y2) x [z1, z2], as written for obstacles and segments
+   auto boxInDie = [&](const int * v){
+      return v[0] >= 0 && v[0] < v[3] && v[3] <= width && v[1] >= 0 && v[1] < v[4] && v[4] <= height &&
+         v[2] >= 0 && v[2] <= v[5] && v[5] < layers;
+   };
+   int values[6];
+   head.routed = false;
+   if(!line("Obstacle_num", values, 1) || values[0] < 0) return fail("expected Obstacle_num <n>");
+   for(int i = values[0]; i > 0; --i){
+      skipBlank();
+      if(row(values, 6) != 6) return fail("expected x1 y1 z1 x2 y2 z2");
+      if(!boxInDie(values)) return fail("obstacle outside the die");
+      Point p1(values[0], values[1], values[2]), p2(values[3], values[4], values[5]);
+      if(!L.addObstacle(p1, p2)) return fail("overlapping obstacles");
+   }
+   if(!line("Net_num", values, 1) || values[0] < 0) return fail("expected Net_num <n>");
+   for(int i = values[0]; i > 0; --i){
+      int id, pin_num;
+      if(!line("Net_id", &id, 1)) return fail("expected Net_id <id>");
+      if(!line("pin_num", &pin_num, 1) || pin_num < 0) return fail("expected pin_num <n>");
+      pins.clear();
+      for(int j = 0; j < pin_num; ++j){
+         int ap_num;
+         if(!line("pin_id", values, 1)) return fail("expected pin_id <i>");
+         if(!line("ap_num", &ap_num, 1) || ap_num < 1) return fail("expected ap_num <n>");
+         for(int k = 0; k < ap_num; ++k){
+            skipBlank();
+            if(row(values, 3) != 3) return fail("expected x y z");
+            if(k == 0) pins.push_back(Point(values[0], values[1], values[2]));
+         }
+         if(!inDie(pins.back().x, pins.back().y, pins.back().z)) return fail("pin outside the die");
+      }
+      vias.clear();
+      h_segments.clear();
+      v_segments.clear();
+      if(peek("Via_num")){//pins only otherwise
+         head.routed = true;
+         int via_num;
+         if(!line("Via_num", &via_num, 1) || via_num < 0) return fail("expected Via_num <n>");
+         for(int k = 0; k < via_num; ++k){
+            skipBlank();
+            const int columns = row(values, 3);
+            if(columns == 2) values[2] = 0;//2-layer cases of earlier releases: the via sits on layer 0
+            else if(columns != 3) return fail("expected x y z");
+            if(!inDie(values[0], values[1], values[2]) || values[2] + 1 >= layers) return fail("via outside the die");
+            vias.push_back(Point(values[0], values[1], values[2]));
+         }
+         for(int vertical = 0; vertical < 2; ++vertical){
+            int seg_num;
+            if(!line(vertical ? "V_segment_num" : "H_segment_num", &seg_num, 1) || seg_num < 0){
+               return fail(vertical ? "expected V_segment_num <n>" : "expected H_segment_num <n>");
+            }
+            std::vector<Segment> & segments = vertical ? v_segments : h_segments;
+            for(int k = 0; k < seg_num; ++k){
+               skipBlank();
+               if(row(values, 6) != 6) return fail("expected x1 y1 z1 x2 y2 z2");
+               if(!boxInDie(values)) return fail("segment outside the die");
+               segments.push_back({{values[0], values[1], values[2], values[3], values[4], values[5]}});
+            }
+         }
+      }
+      L.loadNet(id, pins, vias, h_segments, v_segments);
+   }
+   skipBlank();
+   if(cur != end) return fail("trailing data after the last net");
+   return true;
+}
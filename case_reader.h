@@ -0,0 +1,61 @@
+#ifndef _CASE_READER_H_
+#define _CASE_READER_H_
+#include <string>
+#include <vector>
+#include "layout.h"
+
+struct Case_header{
+   int width;
+   int height;
+   int layers;
+   long long total_wl;//as written in the file, Verify_result::wl recomputes it
+   long long total_via;
+   bool routed;//set by load: the nets come with their vias and segments, not as the pins-only cases of the RL env
+};
+
+/**
+ * Reader of the text cases written by Layout::saveResult:
+ *
+ * Width 0 <width>, Height 0 <height>, total_WL <wl>, total_via <vias>, Layer <layers>, track<i> <start> <spacing> <direction>
+ * Obstacle_num <n>, <x1 y1 z1 x2 y2 z2> per obstacle
+ * Net_num <n>, per net: Net_id <id>, pin_num <n>, per pin: pin_id <i>, ap_num <n>, <x y z> per access point
+ *    then, unless the case holds pins only: Via_num <n>, <x y z> per via (<x y> for the 2-layer cases of earlier releases),
+ *    H_segment_num <n>, V_segment_num <n>, <x1 y1 z1 x2 y2 z2> per segment
+ *
+ * The file is mapped and scanned in place with a hand-rolled integer scanner, nothing is copied or tokenized,
+ * and the scratch vectors of a net are reused from one file to the next.
+ * Only the first access point of a pin is kept, a Net has one Point per pin.
+ */
+class CaseReader{
+public:
+   CaseReader();
+   ~CaseReader();
+
+   bool open(const std::string & filename);//maps the file and parses its header
+   const Case_header & header() const{ return head; }
+   //obstacles and nets of the opened file into L, just reset and of the header's die size,
+   //coordinates are checked against the die, the rest of legality is left to a Verifier
+   bool load(Layout & L);
+   const std::string & error() const{ return message; }//why open or load failed, with the line
+private:
+   void close();
+   bool fail(const std::string & what);
+   void skipBlank();//spaces, tabs and newlines
+   bool peek(const char * key);//the next token is key, nothing consumed
+   bool line(const char * key, int * values, int n);//"key v1 .. vn" on one line
+   int row(int * values, int n);//up to n integers up to the end of the line, -1 on a malformed or longer row
+
+   std::string filename;
+   char * data;
+   size_t size;
+   const char * cur;
+   const char * end;
+   Case_header head;
+   std::string message;
+   std::vector<Point> pins;
+   std::vector<Point> vias;
+   std::vector<Segment> h_segments;
+   std::vector<Segment> v_segments;
+};
+
+#endif
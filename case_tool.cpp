@@ -0,0 +1,222 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include <stdlib.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "layout.h"
+#include "case_reader.h"
+#include "scheduler.h"
+#include "verifier.h"
+#include "writer.h"
+
+/**
+ * Tools over existing text cases, read with a CaseReader (see case_reader.h):
+ *
+ * ./case_tool [--threads N] verify <case>...
+ * ./case_tool [--threads N] convert <out.bin> <case>...
+ * ./case_tool [--threads N] [--seed S] [--rng xoshiro|mt19937] [--engine dfs|best-first] extend <out_dir> <net_num> <pin_num> <case>...
+ *
+ * <case>: a case file or a directory, whose <i>.txt files are taken (manifests skipped), in id order
+ *
+ * verify: checks every case with a Verifier and its total_WL against the recomputed wirelength,
+ *         prints the illegal ones, exits with 1 if any case is illegal or unreadable
+ * convert: writes every case into one binary container (see writer.h), the case id is the number ending the file name
+ * extend: routes <net_num> more nets of <pin_num> pins around the obstacles and nets of every case,
+ *         written to <out_dir> under the same file name, case i is a pure function of (S, i)
+ * --threads N: number of worker threads (0 = all cores, default 1)
+ */
+
+//case id of a file: the number ending its name, "12.txt" and "id_12.txt" are case 12, -1 without one
+static int caseId(const std::string & path){
+    size_t end = path.size() - (path.size() >= 4 && path.compare(path.size() - 4, 4, ".txt") == 0 ? 4 : 0);
+    size_t beg = end;
+    while(beg > 0 && path[beg - 1] >= '0' && path[beg - 1] <= '9') --beg;
+    return beg < end ? atoi(path.substr(beg, end - beg).c_str()) : -1;
+}
+
+static std::string baseName(const std::string & path){
+    const size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+static void listCases(const std::string & path, std::vector<std::string> & files){
+    struct stat st;
+    if(stat(path.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)){
+        files.push_back(path);
+        return;
+    }
+    DIR * dir = opendir(path.c_str());
+    if(dir == nullptr) return;
+    std::vector<std::string> found;
+    for(struct dirent * entry; (entry = readdir(dir)) != nullptr;){
+        const std::string name(entry->d_name);
+        if(name.size() > 4 && name.compare(name.size() - 4, 4, ".txt") == 0 && name.compare(0, 8, "manifest") != 0){
+            found.push_back(path + "/" + name);
+        }
+    }
+    closedir(dir);
+    std::sort(found.begin(), found.end(), [](const std::string & a, const std::string & b){
+        const int ia = caseId(a), ib = caseId(b);
+        return ia != ib ? ia < ib : a < b;
+    });
+    files.insert(files.end(), found.begin(), found.end());
+}
+
+int main(int argc, char *argv[]){
+    int thread_num = 1;
+    uint64_t seed = time(0);
+    bool seed_given = false;
+    Search_engine engine = DFS_ENGINE;
+    Random_engine rng = XOSHIRO_ENGINE;
+    std::vector<std::string> args;
+    for(int i = 1; i < argc; ++i){
+        std::string arg(argv[i]);
+        if(arg == "--threads" && i + 1 < argc){
+            thread_num = atoi(argv[++i]);
+        }else if(arg == "--seed" && i + 1 < argc){
+            seed = strtoull(argv[++i], nullptr, 10);
+            seed_given = true;
+        }else if(arg == "--engine" && i + 1 < argc){
+            std::string name(argv[++i]);
+            if(name != "dfs" && name != "best-first"){
+                std::cerr << "--engine must be dfs or best-first" << std::endl;
+                return 1;
+            }
+            engine = (name == "best-first") ? BEST_FIRST_ENGINE : DFS_ENGINE;
+        }else if(arg == "--rng" && i + 1 < argc){
+            std::string name(argv[++i]);
+            if(name != "xoshiro" && name != "mt19937"){
+                std::cerr << "--rng must be xoshiro or mt19937" << std::endl;
+                return 1;
+            }
+            rng = (name == "mt19937") ? MT19937_ENGINE : XOSHIRO_ENGINE;
+        }else{
+            args.push_back(arg);
+        }
+    }
+    const std::string command = args.empty() ? "" : args[0];
+    const size_t first_case = command == "verify" ? 1 : command == "convert" ? 2 : command == "extend" ? 4 : args.size() + 1;
+    if(first_case >= args.size()){
+        std::cerr << "check case_tool.cpp for args" << std::endl;
+        return 1;
+    }
+    std::vector<std::string> files;
+    for(size_t i = first_case; i < args.size(); ++i){
+        listCases(args[i], files);
+    }
+    int net_num = 0, pin_num = 0;
+    std::string out_dir;
+    std::unique_ptr<BinaryWriter> writer;
+    if(command == "convert"){
+        writer.reset(new BinaryWriter(args[1]));
+    }else if(command == "extend"){
+        out_dir = args[1];
+        net_num = atoi(args[2].c_str());
+        pin_num = atoi(args[3].c_str());
+        if(net_num <= 0 || pin_num < 2){
+            std::cerr << "extend needs net_num > 0 and pin_num >= 2" << std::endl;
+            return 1;
+        }
+        struct stat st = {0};
+        if (stat(out_dir.c_str(), &st) == -1) mkdir(out_dir.c_str(), 0700);
+        if(!seed_given) std::cerr << "seed " << seed << std::endl;
+    }
+
+    if(thread_num <= 0) thread_num = std::max(1u, std::thread::hardware_concurrency());
+    thread_num = std::max(1, std::min<int>(thread_num, files.size()));
+    Scheduler scheduler(files.size(), thread_num);
+    std::mutex log_lock;
+    int failed = 0;
+    long long nets = 0, cells = 0;
+    const auto start = std::chrono::steady_clock::now();
+    auto worker = [&](int w){
+        CaseReader reader;
+        std::unique_ptr<Layout> L;//reallocated only when the die size changes
+        std::unique_ptr<Verifier> verifier;
+        std::vector<int32_t> record;
+        std::ostringstream log;
+        int i;
+        while(scheduler.next(w, i)){
+            const std::string & file = files[i];
+            const int id = caseId(file) >= 0 ? caseId(file) : i;
+            bool ok = reader.open(file);
+            if(ok){
+                const Case_header & head = reader.header();
+                if(!L || L->getWidth() != head.width || L->getHeight() != head.height || L->getLayers() != head.layers){
+                    L.reset(new Layout(head.width, head.height, head.layers, id, 0, rng));
+                    verifier.reset();
+                }
+                L->reset(id, caseSeed(seed, 0, id, 0));
+                ok = reader.load(*L);
+            }
+            if(!ok){
+                std::lock_guard<std::mutex> guard(log_lock);
+                std::cerr << reader.error() << std::endl;
+                failed++;
+                continue;
+            }
+            if(command == "verify"){
+                if(!reader.header().routed){
+                    std::lock_guard<std::mutex> guard(log_lock);
+                    std::cout << file << ": pins only, nothing to verify" << std::endl;
+                    failed++;
+                    continue;
+                }
+                if(!verifier) verifier.reset(new Verifier(L->getWidth(), L->getHeight(), L->getLayers()));
+                const Verify_result result = verifier->verify(*L);
+                const bool legal = result.legal() && result.wl == reader.header().total_wl;
+                std::lock_guard<std::mutex> guard(log_lock);
+                nets += result.nets;
+                cells += result.cells;
+                if(!legal){
+                    failed++;
+                    std::cout << file << ": ";
+                    if(result.wl != reader.header().total_wl){
+                        std::cout << "total_WL " << reader.header().total_wl << " recomputed " << result.wl << ", ";
+                    }
+                    result.print(std::cout);
+                }
+            }else if(command == "convert"){
+                L->serialize(record);
+                writer->write(record);
+            }else{
+                std::vector<std::pair<int, Net_config>> net_configs;
+                L->autoConfig(net_configs, net_num, pin_num);
+                for(std::pair<int, Net_config> & c : net_configs){
+                    c.second.engine = engine;
+                }
+                L->generateNets(net_configs, log);
+                const std::string out_name = out_dir + "/" + baseName(file);
+                const bool saved = L->saveResult(out_name);
+                std::lock_guard<std::mutex> guard(log_lock);
+                std::cout << baseName(file) << ": " << log.str();
+                log.str("");
+                if(!saved){
+                    std::cerr << "Cannot save " << out_name << "." << std::endl;
+                    failed++;
+                }
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for(int w = 1; w < thread_num; ++w){
+        workers.emplace_back(worker, w);
+    }
+    worker(0);
+    for(std::thread & t : workers){
+        t.join();
+    }
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cerr << command << ": " << files.size() << " cases, " << failed << (command == "verify" ? " illegal or unreadable" : command == "extend" ? " unreadable or not saved" : " unreadable");
+    if(command == "verify") std::cerr << ", " << nets << " nets, " << cells << " cells";
+    std::cerr << ", " << ms << " ms" << std::endl;
+    return failed ? 1 : 0;
+}
@@ -1,12 +1,10 @@
 #include "debugger.h"
+#include <cstdlib>
 
-void __M_Assert(const char* expr_str, bool expr, const char* file, const char* function, int line, const std::string msg)
+void __M_Assert(const char* expr_str, const char* file, const char* function, int line, const char* msg)
 {
-    if (!expr)
-    {
-        std::cerr << "Assert failed:\t" << msg << "\n"
-            << "Expected:\t" << expr_str << "\n"
-            << "Source:\t\t" << file <<": "<< function << "()" << ", line " << line << "\n";
-        abort();
-    }
+    std::cerr << "Assert failed:\t" << msg << "\n"
+        << "Expected:\t" << expr_str << "\n"
+        << "Source:\t\t" << file <<": "<< function << "()" << ", line " << line << "\n";
+    abort();
 }
@@ -1,16 +1,16 @@
 #ifndef _DEBUGGER_H_
-#define _DEBUGGER_
+#define _DEBUGGER_H_
 
 #include <string>
 #include <iostream>
 //#define SHOW
-#define DEBUG
+//DEBUG is set by the build: make checked (-DDEBUG) keeps every M_Assert and checkLegal, make release (-DNDEBUG) compiles them away
 #ifdef DEBUG
-#   define M_Assert(Expr, Msg)  __M_Assert(#Expr, Expr, __FILE__, __FUNCTION__, __LINE__, Msg)
+#   define M_Assert(Expr, Msg)  ((Expr) ? (void)0 : __M_Assert(#Expr, __FILE__, __FUNCTION__, __LINE__, Msg))
 #else
-#   define M_Assert(Expr, Msg) ;
+#   define M_Assert(Expr, Msg) ((void)0)
 #endif
 
-void __M_Assert(const char* expr_str, bool expr, const char* file, const char* function, int line, const std::string msg);
+[[noreturn]] void __M_Assert(const char* expr_str, const char* file, const char* function, int line, const char* msg);
 
-#endif
\ No newline at end of file
+#endif
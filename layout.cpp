@@ -1,32 +1,80 @@
 #include "layout.h"
+#include "verifier.h"
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
 
-#define MAX_LAYER 2  // this limits searchEngine to only route on layer 0 & 1
+//searchEngineBestFirst: priority = depth + weight * distance from the start - weight * blocked neighbors + momentum + jitter
+#define BF_DISTANCE_WEIGHT 0.25
+#define BF_CONGESTION_WEIGHT 0.5
+#define BF_EXPAND_BUDGET 4  // at most wl_upper_bound * BF_EXPAND_BUDGET cells expanded per search
+#define REGION_LABEL_COST 4  // a cell expanded by searchEngine costs about as much as labeling 16 cells
 
-Layout::Layout(int _width, int _height, int _layers, int idx) : layout_idx(idx), width(_width), height(_height), layers(_layers), length(_width * _height * _layers), r_gen(idx + time(0)){
+Layout::Layout(int _width, int _height, int _layers, int idx) : Layout(_width, _height, _layers, idx, idx + time(0)){
+}
+
+Layout::Layout(int _width, int _height, int _layers, int idx, uint64_t seed, Random_engine engine) : layout_idx(idx), width(_width), height(_height), layers(_layers), length(_width * _height * _layers), r_gen(seed, engine), net_used(0), route_threads(1), route_batch(1){
    // assert(layers == 2);
-   grids = new int[length]();
-   /** LAYER: only 2 layers */
-   h_edges.resize(width);
-   for(std::vector<bool> & h_e : h_edges){
-      h_e.resize(height - 1, false);
-   }
-   v_edges.resize(height);
-   for(std::vector<bool> & v_e : v_edges){
-      v_e.resize(width - 1, false);
-   }
-   visited = new bool[length]();
+   reset(idx, seed);
 }
 
 Layout::~Layout(){
-   for(Net * net : nets){
-      delete net;
+}
+
+void Layout::reset(int idx, uint64_t seed){
+   layout_idx = idx;
+   r_gen.seed(seed);
+   if(grids.empty()){//first use or archived, (re)allocate storage
+      grids.resize(length);
+      edges.resize(layers);
+      for(int z = 0; z < layers; ++z){
+         if(z & 1){
+            edges[z].resize(width, height - 1);
+         }else{
+            edges[z].resize(height, width - 1);
+         }
+      }
+      visited.assign(length, 0);
+      visit_epoch = 1;
+      regions.assign(length, -1);
+      obstacle_tracks.resize(layers);
+      for(int z = 0; z < layers; ++z){
+         if(z & 1){
+            obstacle_tracks[z].resize(width, height, width - 1, height - 1);
+         }else{
+            obstacle_tracks[z].resize(height, width, height - 1, width - 1);
+         }
+      }
+   }else{
+      for(BitMatrix & plane : edges){
+         plane.clear();
+      }
+      for(TrackIndex & index : obstacle_tracks){
+         index.clear();
+      }
    }
-   if(grids != nullptr){
-      delete [] grids;
+   std::fill(grids.begin(), grids.end(), 0);
+   regions_valid = false;
+   region_failed_cells = 0;
+   dirty_edges.clear();
+   free_count_valid = false;
+   for(Net * n : nets){
+      n->reset();
    }
-   if(visited != nullptr){
-      delete [] visited;
+   nets.clear();
+   net_used = 0;
+   obstacles.clear();
+   budget.clear();
+}
+
+Net * Layout::allocNet(int id, const std::vector<Point> & pins){
+   if(net_used == net_arena.size()){
+      net_arena.emplace_back(id, pins);
+   }else{
+      net_arena[net_used].assign(id, pins);
    }
+   return &net_arena[net_used++];
 }
 
 void Layout::autoConfig(std::vector<std::pair<int, Net_config>> & net_configs, int net_num, int pin_num){
@@ -35,111 +83,389 @@ void Layout::autoConfig(std::vector<std::pair<int, Net_config>> & net_configs, i
    const int reroute_num = size * 0.15 * net_num * pin_num;
    const float momentum = 0.85;
    Net_config net_config(min_wl, max_wl, wl_limit, pin_num, reroute_num, momentum);
+   net_config.cost_limit = (long long)BUDGET_COST_LIMIT * pin_num * wl_limit;
    net_configs.push_back({net_num, net_config});
 }
 
 void Layout::generateObstacles(const std::vector<int> & obs_num, const std::vector<std::pair<int,int>> & obs_size_range){
+   Phase_timer timer(stats.obstacle_time);
    assert((int)obs_num.size() <= layers);
    assert(obs_num.size() == obs_size_range.size());
    for(int i = 0; i < (int)obs_num.size(); ++i){
-      for (int j = 0, counter = 0; j < obs_num[i] && counter < 10;) {
-         int obs_w = 1, obs_h = 1;
-         if(i % 2){//vertical layer
-            obs_h = randInt(r_gen, obs_size_range[i].first, obs_size_range[i].second);
-         }else{
-            obs_w = randInt(r_gen, obs_size_range[i].first, obs_size_range[i].second);
+      //an obstacle covers part of one track: a row on horizontal layers, a column on vertical layers,
+      //never the last track nor the last cell of its track (see the TrackIndex sample bounds)
+      TrackIndex & index = obstacle_tracks[i];
+      int rejected = 0;
+      for (int j = 0; j < obs_num[i];) {
+         const int obs_len = randInt(r_gen, obs_size_range[i].first, obs_size_range[i].second);
+         //draw uniformly among the positions free of obstacles
+         const long long feasible = index.countFree(obs_len);
+         if(feasible == 0){
+            if(obs_len <= obs_size_range[i].first) break;//not even the smallest obstacle fits anymore
+            continue;
          }
-         int x = randInt(r_gen, 0, width - obs_w - 1);
-         int y = randInt(r_gen, 0, height - obs_h - 1);
-         Point obs_p1(x, y, i);
-         Point obs_p2(x + obs_w, y + obs_h, i);
-         if(!addObstacle(obs_p1, obs_p2)){
-            counter++;
-         }else{
-            j++;
+         std::uniform_int_distribution<long long> distribution(0, feasible - 1);
+         int track, beg;
+         index.nthFree(distribution(r_gen), obs_len, track, beg);
+         Point obs_p1 = (i % 2) ? Point(track, beg, i) : Point(beg, track, i);
+         Point obs_p2 = (i % 2) ? Point(track + 1, beg + obs_len, i) : Point(beg + obs_len, track + 1, i);
+         if(nets.size() && !isEmpty(obs_p1, obs_p2)){//the index only knows obstacles
+            if(++rejected >= 10 * obs_num[i]) break;
+            continue;
          }
+         placeObstacle(obs_p1, obs_p2);
+         j++;
       }
    }
 }
 
-int Layout::generateNets(const std::vector<std::pair<int, Net_config>> & net_configs){
+void Layout::setRouteThreads(int threads, int batch){
+   route_threads = std::max(1, threads);
+   route_batch = batch > 0 ? std::max(batch, route_threads) : route_threads * ROUTE_BATCH_PER_THREAD;
+}
+
+int Layout::generateNets(const std::vector<std::pair<int, Net_config>> & net_configs, std::ostream & log){
+   if(route_threads > 1){
+      return generateNetsParallel(net_configs, log);
+   }
    int total_nets = 0;
    for(const std::pair<int, Net_config> & net_config : net_configs){
-      int counter = 0;
+      int counter = 0, abandoned = 0;
       for(int i = 0; i < net_config.first; ++i){
+         if(overBudget(net_config.second)){//the rest of the nets, on top of the ones given up by generateNet
+            abandoned += net_config.first - i;
+            stats.nets_abandoned += net_config.first - i;
+            break;
+         }
          if(generateNet(net_config.second)){
             counter++;
             total_nets++;
+         }else if(route_abandoned){
+            abandoned++;
          }
       }
-      std::cout << "Created " << net_config.second.pin_num << " pins net: " << counter << std::endl;
+      log << "Created " << net_config.second.pin_num << " pins net: " << counter;
+      if(abandoned) log << " (" << abandoned << " abandoned)";
+      log << std::endl;
    }
    return total_nets;
 }
 
+//speculative routing of one case on several threads:
+//nets are taken in batches of route_batch slots, slot k is routed by generateNet on shadow k % route_threads,
+//a private copy of the grid synced at the start of the batch (with the earlier slots of the same shadow in place).
+//slots are then validated in order against the nets committed before them in the batch:
+//a net whose cells or pin neighbors were taken meanwhile is dropped and routed again at the front of the next batch,
+//where slot 0 can't conflict. the shadows finally drop their own nets and replay the commits of the batch.
+//every slot draws its seed from r_gen, so timing never changes the case
+int Layout::generateNetsParallel(const std::vector<std::pair<int, Net_config>> & net_configs, std::ostream & log){
+   const int threads = route_threads;
+   while((int)route_shadows.size() < threads){
+      route_shadows.emplace_back(new Layout(width, height, layers, layout_idx, 0));
+   }
+   if((int)route_slots.size() < route_batch){
+      route_slots.resize(route_batch);
+   }
+
+   //workers live for the whole call, run(job) runs job(t) on every shadow t and waits for all of them
+   std::mutex lock;
+   std::condition_variable wake, finished;
+   std::function<void(int)> job;
+   int phase = 0, running = 0;
+   bool stop = false;
+   auto run = [&](const std::function<void(int)> & f){
+      {
+         std::lock_guard<std::mutex> guard(lock);
+         job = f;
+         running = threads - 1;
+         ++phase;
+      }
+      wake.notify_all();
+      f(0);
+      std::unique_lock<std::mutex> guard(lock);
+      finished.wait(guard, [&]{ return running == 0; });
+   };
+   std::vector<std::thread> workers;
+   for(int t = 1; t < threads; ++t){
+      workers.emplace_back([&, t]{
+         for(int seen = 0; ;){
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [&]{ return stop || phase != seen; });
+            if(stop) return;
+            seen = phase;
+            guard.unlock();
+            job(t);
+            guard.lock();
+            if(--running == 0) finished.notify_one();
+         }
+      });
+   }
+
+   run([&](int t){ route_shadows[t]->syncShadow(*this); });
+   int total_nets = 0;
+   for(const std::pair<int, Net_config> & net_config : net_configs){
+      int counter = 0, abandoned = 0;
+      int fresh = net_config.first, retried = 0;
+      while(fresh + retried > 0){
+         if(overBudget(net_config.second)){
+            abandoned += fresh + retried;
+            stats.nets_abandoned += fresh + retried;
+            break;
+         }
+         const int slot_num = std::min(route_batch, fresh + retried);
+         fresh -= slot_num - std::min(retried, slot_num);
+         for(int k = 0; k < slot_num; ++k){
+            route_slots[k].config = &net_config.second;
+            const uint64_t high = r_gen();//two statements, the order of operands is unspecified
+            route_slots[k].seed = (high << 32) | r_gen();
+         }
+         run([&](int t){
+            Layout & shadow = *route_shadows[t];
+            for(int k = t; k < slot_num; k += threads){
+               Route_slot & slot = route_slots[k];
+               shadow.r_gen.seed(slot.seed);
+               shadow.budget = budget;
+               slot.routed = shadow.generateNet(*slot.config);
+               slot.spent = shadow.route_spent;
+               slot.abandoned = shadow.route_abandoned;
+               if(slot.routed){
+                  slot.shadow_net = shadow.nets.size() - 1;
+                  slot.cells.assign(shadow.route_path.begin(), shadow.route_path.end());
+               }
+            }
+         });
+
+         route_log.clear();
+         retried = 0;
+         for(int k = 0; k < slot_num; ++k){
+            Route_slot & slot = route_slots[k];
+            budget.record(slot.routed, slot.spent);//a conflict isn't the net's fault, it's routed again
+            if(slot.abandoned) abandoned++;//counted in the stats of the shadow
+            if(!slot.routed) continue;
+            const Layout & shadow = *route_shadows[k % threads];
+            bool conflict = false;
+            for(int cell : slot.cells){
+               if(grids[cell] != 0){
+                  conflict = true;
+                  break;
+               }
+            }
+            const Net & routed = *shadow.nets[slot.shadow_net];
+            for(const Point & p : routed.pins){//a pin committed next to it in this batch, see generateNet
+               for(int x = p.x - 1; !conflict && x <= p.x + 1; x += 2){
+                  if(x >= 0 && x < width && getGrid(x, p.y, p.z) == 2 && shadow.getGrid(x, p.y, p.z) != 2){
+                     conflict = true;
+                  }
+               }
+            }
+            if(conflict){
+               stats.route_conflicts++;
+               retried++;
+               continue;
+            }
+            for(int cell : slot.cells){
+               const int value = shadow.grids[cell];
+               setCell(cell, value);
+               route_log.push_back({cell, value});
+            }
+            Net * net = allocNet(nets.size(), routed.pins);
+            net->vias = routed.vias;
+            net->h_segments = routed.h_segments;
+            net->v_segments = routed.v_segments;
+            net->wl = routed.wl;
+            nets.push_back(net);
+            stats.nets_created++;
+            counter++;
+            total_nets++;
+         }
+
+         run([&](int t){
+            Layout & shadow = *route_shadows[t];
+            for(int k = t; k < slot_num; k += threads){
+               for(int cell : route_slots[k].cells){
+                  if(route_slots[k].routed) shadow.setCell(cell, 0);
+               }
+            }
+            for(const std::pair<int, int> & e : route_log){
+               shadow.setCell(e.first, e.second);
+            }
+            for(Net * n : shadow.nets){
+               n->reset();
+            }
+            shadow.nets.clear();
+            shadow.net_used = 0;
+         });
+      }
+      log << "Created " << net_config.second.pin_num << " pins net: " << counter;
+      if(abandoned) log << " (" << abandoned << " abandoned)";
+      log << std::endl;
+   }
+   {
+      std::lock_guard<std::mutex> guard(lock);
+      stop = true;
+   }
+   wake.notify_all();
+   for(std::thread & w : workers){
+      w.join();
+   }
+   for(std::unique_ptr<Layout> & shadow : route_shadows){//counters of the shadows, nets_created only counts commits
+      shadow->stats.nets_created = 0;
+      stats += shadow->stats;
+      shadow->stats.clear();
+   }
+   return total_nets;
+}
+
+//start routing on a copy of the grid of master, obstacles and nets included
+void Layout::syncShadow(const Layout & master){
+   r_gen.setEngine(master.r_gen.getEngine());
+   std::copy(master.grids.begin(), master.grids.end(), grids.begin());
+   free_count_valid = false;
+   regions_valid = false;
+   region_failed_cells = 0;
+   for(Net * n : nets){
+      n->reset();
+   }
+   nets.clear();
+   net_used = 0;
+}
+
 bool Layout::addObstacle(Point & p1, Point & p2){
    M_Assert(p1.x <= p2.x && p1.y <= p2.y && p1.z <= p2.z, "invalid obstacle");
    //check if position is legal
-   for(int x = p1.x; x < p2.x; x++){
-      for(int y = p1.y; y < p2.y; y++){
-         for(int z = p1.z; z <= p2.z; z++){
+   if(!isEmpty(p1, p2)){
+      return false;
+   }
+   placeObstacle(p1, p2);
+   return true;
+}
+
+void Layout::countFreeCells(){
+   free_count = std::count(grids.begin(), grids.begin() + width * height, 0);//cellIndex(x, y, 0) == y * width + x
+   free_count_valid = true;
+}
+
+//uniform over the empty bottom-layer cells, and a function of the grid and r_gen only:
+//random cells are tried until one is empty (1 / free fraction tries expected), a congested layer falls back
+//to a rank drawn among the free_count empty cells and found by a scan
+int Layout::drawFreeCell(){
+   const int plane = width * height;
+   for(int i = 0; i < FREE_DRAW_TRIES; ++i){
+      const int cell = randInt(r_gen, 0, plane - 1);
+      if(grids[cell] == 0) return cell;
+   }
+   int rank = randInt(r_gen, 0, free_count - 1);
+   for(int cell = 0; ; ++cell){
+      if(grids[cell] == 0 && rank-- == 0) return cell;
+   }
+}
+
+//cells [p1.x, p2.x) x [p1.y, p2.y) x [p1.z, p2.z] are all empty
+bool Layout::isEmpty(const Point & p1, const Point & p2) const{
+   for(int z = p1.z; z <= p2.z; z++){
+      for(int x = p1.x; x < p2.x; x++){
+         for(int y = p1.y; y < p2.y; y++){
             if(getGrid(x, y, z) != 0){
                return false;
             }
          }
       }
    }
-   //set obstacle in the grid map
-   for(int x = p1.x; x < p2.x; x++){
-      for(int y = p1.y; y < p2.y; y++){
-         for(int z = p1.z; z <= p2.z; z++){
-            setGrid(x, y, z, -1);
+   return true;
+}
+
+//marks empty cells [p1.x, p2.x) x [p1.y, p2.y) x [p1.z, p2.z] as an obstacle, one contiguous run per track
+void Layout::placeObstacle(const Point & p1, const Point & p2){
+   for(int z = p1.z; z <= p2.z; z++){
+      const bool vertical = z & 1;
+      const int track_beg = vertical ? p1.x : p1.y, track_end = vertical ? p2.x : p2.y;
+      const int beg = vertical ? p1.y : p1.x, end = vertical ? p2.y : p2.x;
+      for(int track = track_beg; track < track_end; ++track){
+         obstacle_tracks[z].insert(track, beg, end);
+         const int idx = vertical ? cellIndex(track, beg, z) : cellIndex(beg, track, z);
+         std::fill(grids.begin() + idx, grids.begin() + idx + (end - beg), -1);
+         if(z == 0 && free_count_valid){//keep the free-cell count in sync, the cells were empty
+            free_count -= end - beg;
          }
       }
    }
    obstacles.push_back({p1, p2});
-   return true;
+   regions_valid = false;
 }
 
 void Layout::archiveAndReset(){
    for(Net * n : nets){
       n->reset();
    }
-   h_edges.clear();
-   v_edges.clear();
-   delete [] grids;
-   grids = nullptr;
-   delete [] visited;
-   visited = nullptr;
+   std::vector<int>().swap(route_path);
+   std::vector<Point>().swap(route_vias);
+   std::vector<int>().swap(route_starts);
+   std::vector<int>().swap(search_path);
+   std::vector<std::pair<int, int>>().swap(search_candidates);
+   std::vector<BitMatrix>().swap(edges);
+   std::vector<int8_t>().swap(grids);
+   std::vector<uint32_t>().swap(visited);
+   free_count_valid = false;
+   std::vector<int>().swap(regions);
+   std::vector<int>().swap(region_sizes);
+   std::vector<int>().swap(region_stack);
+   regions_valid = false;
+   std::vector<TrackIndex>().swap(obstacle_tracks);
+   std::vector<long long>().swap(obstacle_starts);
+   std::vector<std::unique_ptr<Layout>>().swap(route_shadows);
 }
 
 bool Layout::generateNet(const Net_config & config){
-   assert(config.pin_num >= 2);//some function doesn't support more than 2 layers
-   std::vector<int>candidates_idx;
-   
-   for(int i = 0; i < length; ++i){
-      if(grids[i] == 0 && i % layers == 0){//empty grid at the bottom layer
-         candidates_idx.push_back(i);
-      }
-   }
-   
-   std::vector<Point>total_path;
-   std::vector<Point>n_vias;
-   std::vector<Point>n_pins;
-   std::shuffle(candidates_idx.begin(), candidates_idx.end(), r_gen);
-   for(int i = 0; i < std::min(config.reroute_num,(int)candidates_idx.size()); ++i){
-      int idx = candidates_idx[i];
-      int x = idx / (height * layers);
-      int y = (idx % (height * layers)) / layers;
-      int z = idx % layers;  
-      //beg_candidates.push_back(Point(x, y, z));
-      Point beg(x, y, z);
-      Point result = searchEngine(beg, randIntNorm(r_gen, config.min_wl, config.max_wl), config.wl_limit, config.momentum1, total_path, n_vias);
-      if(result.x != -1){
+   assert(config.pin_num >= 2);
+   std::vector<int> & total_path = route_path;
+   std::vector<Point> & n_vias = route_vias;
+   std::vector<Point> & n_pins = route_pins;
+   total_path.clear();
+   n_vias.clear();
+   n_pins.clear();
+   if(!free_count_valid){//first net of the case, obstacles are in place
+      countFreeCells();
+   }
+   long long spent = 0;//cells expanded by the searches of this net
+   auto abandoned = [&]{ return config.cost_limit > 0 && spent > config.cost_limit; };
+   auto finish = [&](bool created){
+      route_spent = spent;
+      route_abandoned = !created && abandoned();
+      budget.record(created, spent);
+      return created;
+   };
+   const int attempts = std::min(config.reroute_num, free_count);
+   for(int i = 0; i < attempts && free_count && !abandoned(); ++i){
+      Point beg;
+      {
+         Phase_timer timer(stats.candidate_time);
+         //draw a start among the empty bottom-layer cells
+         int cell = drawFreeCell();
+         beg = Point(cell % width, cell / width, 0);
+      }
+      const size_t wl_lower_bound = randIntNorm(r_gen, config.min_wl, config.max_wl);
+      if(regions_valid && (size_t)regionBound(beg) < wl_lower_bound){//doomed, the search can't find that many cells
+         stats.skipped_starts++;
+         continue;
+      }
+      const long long expanded = stats.cells_expanded;
+      Point result = search(config, beg, wl_lower_bound, config.momentum1, total_path, n_vias);
+      const long long cells = stats.cells_expanded - expanded;
+      spent += cells;
+      if(result.x == -1){
+         searchFailed(cells);
+      }else{
          // neighbor pins might make the net "redundant" during training
          // triggers assertion fail: "net_queue->size()"
-         if (std::abs(beg.x - result.x) == 1 && beg.y == result.y) continue;
-         M_Assert(result.z == 0, "result.z == 0");  // under layer = 2
+         if (std::abs(beg.x - result.x) == 1 && beg.y == result.y){
+            stats.rejected_pins++;
+            //release the path, later pins must not branch off a wire that reaches no pin
+            recoverGridAndEdge(total_path);
+            total_path.clear();
+            n_vias.clear();
+            continue;
+         }
+         M_Assert(result.z == 0, "pins are on layer 0");
          n_pins.push_back(beg);
          n_pins.push_back(result);
          setGrid(beg.x, beg.y, beg.z, 2);
@@ -149,31 +475,50 @@ bool Layout::generateNet(const Net_config & config){
    }
    if(n_pins.empty()){
       recoverGridAndEdge(total_path);
-      return false;
+      if(abandoned()){
+         stats.nets_abandoned++;
+      }else{
+         stats.nets_failed++;
+      }
+      return finish(false);
    }
 
    //route the rest pins
    for(int i = 2; i < config.pin_num; ++i){
-      std::vector<Point>candidates_beg;
-      for(Point & p_in_path : total_path){
-         int status = getGrid(p_in_path.x, p_in_path.y, p_in_path.z);
-         if(status == 1 || status == 2){//wire or pin
-            candidates_beg.push_back(p_in_path);
-            M_Assert(p_in_path.z <= 1, "p_in_path.z <= 1");  // under layer = 2
-         }
-      }
-      std::shuffle(candidates_beg.begin(), candidates_beg.end(), r_gen);
-      for(int j = 0; j < std::min(config.reroute_num, (int)candidates_beg.size()); ++j){
-         int x = candidates_beg[j].x;
-         int y = candidates_beg[j].y;
-         int z = candidates_beg[j].z;
-         Point result = searchEngine(Point(x, y, z), randIntNorm(r_gen, config.min_wl, config.max_wl), config.wl_limit, config.momentum2, total_path, n_vias);
-         if(result.x != -1){
+      std::vector<int> & candidates_beg = route_starts;
+      {
+         Phase_timer timer(stats.candidate_time);
+         candidates_beg.clear();
+         for(int cell : total_path){
+            int status = grids[cell];
+            if(status == 1 || status == 2){//wire or pin
+               candidates_beg.push_back(cell);
+            }
+         }
+         std::shuffle(candidates_beg.begin(), candidates_beg.end(), r_gen);
+      }
+      for(int j = 0; j < std::min(config.reroute_num, (int)candidates_beg.size()) && !abandoned(); ++j){
+         const Point beg = cellPoint(candidates_beg[j]);
+         const size_t wl_lower_bound = randIntNorm(r_gen, config.min_wl, config.max_wl);
+         if(regions_valid && (size_t)regionBound(beg) < wl_lower_bound){
+            stats.skipped_starts++;
+            continue;
+         }
+         const long long expanded = stats.cells_expanded;
+         Point result = search(config, beg, wl_lower_bound, config.momentum2, total_path, n_vias);
+         const long long cells = stats.cells_expanded - expanded;
+         spent += cells;
+         if(result.x == -1){
+            searchFailed(cells);
+         }else{
             // neighbor pins might make the net "redundant" during training
             // triggers assertion fail: "net_queue->size()"
-            if ((result.x - 1 >= 0) && (getGrid(result.x - 1, result.y, result.z) == 2)) continue;
-            if ((result.x + 1 < width) && (getGrid(result.x + 1, result.y, result.z) == 2)) continue;
-            M_Assert(result.z == 0, "result.z == 0");  // under layer = 2
+            if (((result.x - 1 >= 0) && (getGrid(result.x - 1, result.y, result.z) == 2)) ||
+               ((result.x + 1 < width) && (getGrid(result.x + 1, result.y, result.z) == 2))){
+               stats.rejected_pins++;
+               continue;
+            }
+            M_Assert(result.z == 0, "pins are on layer 0");
             n_pins.push_back(result);
             setGrid(result.x, result.y, result.z, 2);
             break;
@@ -181,288 +526,708 @@ bool Layout::generateNet(const Net_config & config){
       }
       if((int)n_pins.size() != i + 1){
          recoverGridAndEdge(total_path);
-         return false;
+         if(abandoned()){
+            stats.nets_abandoned++;
+         }else{
+            stats.nets_failed++;
+         }
+         return finish(false);
       }
    }
-   Net * net = new Net(nets.size(), n_pins);
+   Net * net = allocNet(nets.size(), n_pins);
    M_Assert((int)net->pins.size() == config.pin_num, "pin number error");
 
    nets.push_back(net);
    path2Wire(net, n_vias);
-   return true;
+   stats.nets_created++;
+   return finish(true);
+}
+
+//the expected cost of one more net exceeds the cost_limit of config, the case stops adding them.
+//Only trusted once BUDGET_WINDOW nets were routed, a few unlucky first nets don't stop a case
+bool Layout::overBudget(const Net_config & config) const{
+   return config.cost_limit > 0 && budget.nets >= BUDGET_WINDOW && budget.netCost() > config.cost_limit;
+}
+
+Net * Layout::loadNet(int id, const std::vector<Point> & pins, const std::vector<Point> & vias,
+   const std::vector<Segment> & h_segments, const std::vector<Segment> & v_segments){
+   Net * net = allocNet(id, pins);
+   net->vias = vias;
+   net->h_segments = h_segments;
+   net->v_segments = v_segments;
+   net->wl = vias.size();
+   for(const Point & p : vias){
+      setGrid(p.x, p.y, p.z, 1);
+      setGrid(p.x, p.y, p.z + 1, 1);
+   }
+   for(int vertical = 0; vertical < 2; ++vertical){
+      for(const Segment & seg : vertical ? v_segments : h_segments){//cells [x1, x2) x [y1, y2) x [z1, z2]
+         for(int z = seg[2]; z <= seg[5]; ++z){
+            for(int x = seg[0]; x < seg[3]; ++x){
+               for(int y = seg[1]; y < seg[4]; ++y){
+                  setGrid(x, y, z, 1);
+               }
+            }
+         }
+         net->wl += (vertical ? seg[4] - seg[1] : seg[3] - seg[0]) - 1;
+      }
+   }
+   for(const Point & p : pins){
+      setGrid(p.x, p.y, p.z, 2);
+   }
+   nets.push_back(net);
+   regions_valid = false;
+   return net;
 }
 
-Point Layout::searchEngine(const Point & beg, size_t wl_lower_bound, size_t wl_upper_bound, float momentum, std::vector<Point> & total_path, std::vector<Point> & n_vias){
-   std::vector<Point>path;
-   std::vector<std::pair<Point, Point>> candidates; //next point, previous point
-   candidates.push_back({beg, beg});
+//randomized DFS over cellIndex ids: along its track a cell's neighbors are id +-1, vias are recomputed from (x, y),
+//candidates, path and neighbor lists live in reused buffers, so an expanded cell allocates nothing
+Point Layout::searchEngine(const Point & beg, size_t wl_lower_bound, size_t wl_upper_bound, float momentum, std::vector<int> & total_path, std::vector<Point> & n_vias){
+   Phase_timer timer(stats.search_time);
+   stats.search_calls++;
+   std::vector<int> & path = search_path;
+   std::vector<std::pair<int, int>> & candidates = search_candidates; //next cell, previous cell
+   const int plane = width * height;
+   const int beg_idx = cellIndex(beg.x, beg.y, beg.z);
+   path.clear();
+   candidates.clear();
+   candidates.push_back({beg_idx, beg_idx});
+   const int beg_status = grids[beg_idx];
    resetVisited();
    while(candidates.size()){
-      Point curr_p = candidates.back().first;
+      const int curr = candidates.back().first;
       candidates.pop_back();
       size_t pre_size = candidates.size();
-      path.push_back(curr_p);
-      int x = curr_p.x;
-      int y = curr_p.y;
-      int z = curr_p.z;
-      setVisited(x, y, z);
-      setGrid(x, y, z, 1);
+      stats.cells_expanded++;
+      path.push_back(curr);
+      const int z = curr / plane;
+      const bool vertical = z & 1;
+      const int track_len = vertical ? height : width;
+      const int track = (curr - z * plane) / track_len, pos = (curr - z * plane) % track_len;
+      const int x = vertical ? track : pos, y = vertical ? pos : track;
+      setVisited(curr);
+      setCell(curr, 1);
 
       if(path.size() >= wl_lower_bound){
          bool flag = true;
          size_t path_size = path.size();
-         M_Assert(z <= 1, "z <= 1");  // under layer = 2
-         for(int z_i = z - 1; z_i >=0; --z_i){
-            if(getGrid(x, y, z_i) != 0){
+         for(int z_i = z - 1; z_i >= 0; --z_i){
+            const int idx = cellIndex(x, y, z_i);
+            if(grids[idx] != 0){
                flag = false;
                break;
             }
-            setGrid(x, y, z_i, 1);
-            path.push_back(Point(x, y, z_i));
+            setCell(idx, 1);
+            path.push_back(idx);
          }
          if(flag){
-            total_path.push_back(path.front());
-            for(size_t i = 1; i < path.size(); ++i){
-               Point & p_in_path = path[i];
-               M_Assert((p_in_path - path[i-1]).manh()==1, "path error");
-               if(p_in_path.x != path[i-1].x){//h_wire
-                  v_edges[p_in_path.y][std::min(p_in_path.x, path[i-1].x)] = true;
-               }else if(p_in_path.y != path[i-1].y){//v_wire
-                  h_edges[p_in_path.x][std::min(p_in_path.y, path[i-1].y)] = true;
-               }else{
-                  n_vias.push_back(Point(p_in_path.x, p_in_path.y, std::min(p_in_path.z, path[i-1].z)));
-               }
-               total_path.push_back(p_in_path);
-            }
+            if(beg_status == 2) setCell(beg_idx, 2);//a pin the net branches off stays a pin
+            recordPath(path, total_path, n_vias);
+            stats.search_successes++;
             return Point(x, y, 0);
          }else{//recover grid mark
             while(path.size() != path_size){
-               Point & tail = path.back();
-               setGrid(tail.x, tail.y, tail.z, 0);
+               setCell(path.back(), 0);
                path.pop_back();
             }
          }
       }
       if(path.size() > wl_upper_bound){
-         return Point(-1,-1,-1);
+         break;
       }
 
-      std::vector<Point> tmp1;
-      std::vector<Point> tmp2;
-      if(z % 2){
-         if(y - 1 >= 0 && getGrid(x, y - 1, z) == 0 && !getVisited(x, y - 1, z)){
-            tmp1.push_back(Point(x, y - 1, z));
-         }
-         if(y + 1 < height && getGrid(x, y + 1, z) == 0 && !getVisited(x, y + 1, z)){
-            tmp1.push_back(Point(x, y + 1, z));
-         }
-         if(z + 1 < MAX_LAYER && getGrid(x, y, z + 1) == 0 && !getVisited(x, y, z + 1)){
-            tmp2.push_back(Point(x, y, z + 1));
-         }
-         if(z - 1 >= 0 && getGrid(x, y, z - 1) == 0 && !getVisited(x, y, z - 1)){
-            tmp2.push_back(Point(x, y, z - 1));
-         }
-      }else{
-         if(x - 1 >= 0 && getGrid(x - 1, y, z) == 0 && !getVisited(x - 1, y, z)){
-            tmp1.push_back(Point(x - 1, y, z));
-         }
-         if(x + 1 < width && getGrid(x + 1, y, z) == 0 && !getVisited(x + 1, y, z)){
-            tmp1.push_back(Point(x + 1, y, z));
-         }
-         if(z + 1 < MAX_LAYER && getGrid(x, y, z + 1) == 0 && !getVisited(x, y, z + 1)){
-            tmp2.push_back(Point(x, y, z + 1));
-         }
-         if(z - 1 >= 0 && getGrid(x, y, z - 1) == 0 && !getVisited(x, y, z - 1)){
-            tmp2.push_back(Point(x, y, z - 1));
-         }
+      //open neighbors: along the track in next[0, along), vias in next[along, num), each pair ordered nearest to beg first
+      int next[4];
+      int num = 0;
+      if(pos - 1 >= 0 && grids[curr - 1] == 0 && !getVisited(curr - 1)){
+         next[num++] = curr - 1;
+      }
+      if(pos + 1 < track_len && grids[curr + 1] == 0 && !getVisited(curr + 1)){
+         next[num++] = curr + 1;
+      }
+      const int along = num;
+      if(z + 1 < layers){
+         const int idx = cellIndex(x, y, z + 1);
+         if(grids[idx] == 0 && !getVisited(idx)) next[num++] = idx;
       }
-      if(tmp1.size() == 2){
-         int dist1 = (tmp1[0] - beg).manh();
-         int dist2 = (tmp1[1] - beg).manh();
+      if(z - 1 >= 0){
+         const int idx = cellIndex(x, y, z - 1);
+         if(grids[idx] == 0 && !getVisited(idx)) next[num++] = idx;
+      }
+      if(along == 2){//pos - 1 and pos + 1
+         const int beg_pos = vertical ? beg.y : beg.x;
+         const int dist1 = std::abs(pos - 1 - beg_pos), dist2 = std::abs(pos + 1 - beg_pos);
          if(dist1 > dist2 || (dist1 == dist2 && randFloat(r_gen) > 0.5)){
-            std::swap(tmp1[0], tmp1[1]);
+            std::swap(next[0], next[1]);
          }
       }
-      if(tmp2.size() == 2){
-         int dist1 = (tmp2[0] - beg).manh();
-         int dist2 = (tmp2[1] - beg).manh();
+      if(num - along == 2){//z + 1 and z - 1
+         const int dist1 = std::abs(z + 1 - beg.z), dist2 = std::abs(z - 1 - beg.z);
          if(dist1 > dist2 || (dist1 == dist2 && randFloat(r_gen) > 0.5)){
-            std::swap(tmp2[0], tmp2[1]);
+            std::swap(next[along], next[along + 1]);
          }
       }
       if(randFloat(r_gen) > momentum){//change direction
-         for(Point & p : tmp1){
-            candidates.push_back({p, curr_p});
-         }
-         for(Point & p : tmp2){
-            candidates.push_back({p, curr_p});
+         for(int k = 0; k < num; ++k){
+            candidates.push_back({next[k], curr});
          }
       }else{
-         for(Point & p : tmp2){
-            candidates.push_back({p, curr_p});
+         for(int k = along; k < num; ++k){
+            candidates.push_back({next[k], curr});
          }
-         for(Point & p : tmp1){
-            candidates.push_back({p, curr_p});
+         for(int k = 0; k < along; ++k){
+            candidates.push_back({next[k], curr});
          }
       }
       if(candidates.size() == pre_size && candidates.size()){//no way to go
-         Point head = path.back();
+         stats.backtracks++;
+         int head = path.back();
          while(head != candidates.back().second){
-            setGrid(head.x, head.y, head.z, 0);
+            setCell(head, 0);
             path.pop_back();
             M_Assert(path.size(), "path size must > 0");
             head = path.back();
          }
       }
    }
+   //failed: release the cells of the partial path, the start keeps its previous mark
+   for(size_t i = 1; i < path.size(); ++i){
+      setCell(path[i], 0);
+   }
+   setCell(beg_idx, beg_status);
    return Point(-1,-1,-1);
 }
 
-void Layout::recoverGridAndEdge(const std::vector<Point> & total_path){
-   for(const Point & p : total_path){
-      setGrid(p.x, p.y, p.z, 0);
-   }
-   for(std::vector<bool> & h_e : h_edges){
-      for(size_t i = 0; i < h_e.size(); ++i){
-         h_e[i] = false;
+//best-first variant: grows a tree of disjoint branches from beg, always expanding the most promising leaf,
+//so a dead end costs a jump to another branch instead of a cell-by-cell backtrack.
+//the grid is only written once a path of the drawn length with a free via down to layer 0 is found.
+Point Layout::searchEngineBestFirst(const Point & beg, size_t wl_lower_bound, size_t wl_upper_bound, float momentum, std::vector<int> & total_path, std::vector<Point> & n_vias){
+   Phase_timer timer(stats.search_time);
+   stats.search_calls++;
+   std::vector<Search_node> & nodes = search_nodes;
+   std::vector<std::pair<float, int>> & heap = search_heap;
+   nodes.clear();
+   heap.clear();
+   nodes.push_back({beg, -1, 1});
+   heap.push_back({0, 0});
+   resetVisited();
+   const size_t budget = wl_upper_bound * BF_EXPAND_BUDGET;
+   int last_depth = 0;
+   for(size_t expanded = 0; heap.size() && expanded < budget;){
+      std::pop_heap(heap.begin(), heap.end());
+      const int n = heap.back().second;
+      heap.pop_back();
+      const Point curr_p = nodes[n].p;
+      const int depth = nodes[n].depth;
+      int x = curr_p.x;
+      int y = curr_p.y;
+      int z = curr_p.z;
+      const int curr = cellIndex(x, y, z);
+      if(getVisited(curr)) continue;//reached by a better branch first
+      setVisited(curr);
+      ++expanded;
+      stats.cells_expanded++;
+      if(depth <= last_depth) stats.backtracks++;//switched to another branch
+      last_depth = depth;
+
+      if((size_t)depth >= wl_lower_bound){
+         bool flag = true;
+         for(int z_i = z - 1; z_i >= 0; --z_i){
+            const int idx = cellIndex(x, y, z_i);
+            if(grids[idx] != 0 || getVisited(idx)){
+               flag = false;
+               break;
+            }
+         }
+         if(flag){
+            std::vector<int> & path = search_path;
+            path.clear();
+            for(int i = n; i != -1; i = nodes[i].parent){
+               path.push_back(cellIndex(nodes[i].p.x, nodes[i].p.y, nodes[i].p.z));
+            }
+            std::reverse(path.begin(), path.end());
+            for(int z_i = z - 1; z_i >= 0; --z_i){
+               path.push_back(cellIndex(x, y, z_i));
+            }
+            for(int cell : path){
+               if(grids[cell] != 2) setCell(cell, 1);//a pin the net branches off stays a pin
+            }
+            recordPath(path, total_path, n_vias);
+            stats.search_successes++;
+            return Point(x, y, 0);
+         }
       }
-   }
-   for(std::vector<bool> & v_e : v_edges){
-      for(size_t i = 0; i < v_e.size(); ++i){
-         v_e[i] = false;
+      if((size_t)depth > wl_upper_bound){
+         continue;
+      }
+
+      Point next[4];
+      bool planar[4];
+      int next_num = 0;
+      if(z % 2){
+         if(y - 1 >= 0){ next[next_num] = Point(x, y - 1, z); planar[next_num++] = true; }
+         if(y + 1 < height){ next[next_num] = Point(x, y + 1, z); planar[next_num++] = true; }
+      }else{
+         if(x - 1 >= 0){ next[next_num] = Point(x - 1, y, z); planar[next_num++] = true; }
+         if(x + 1 < width){ next[next_num] = Point(x + 1, y, z); planar[next_num++] = true; }
+      }
+      if(z + 1 < layers){ next[next_num] = Point(x, y, z + 1); planar[next_num++] = false; }
+      if(z - 1 >= 0){ next[next_num] = Point(x, y, z - 1); planar[next_num++] = false; }
+      for(int k = 0; k < next_num; ++k){
+         const Point & p = next[k];
+         const int idx = cellIndex(p.x, p.y, p.z);
+         if(grids[idx] != 0 || getVisited(idx)) continue;
+         int blocked = 0;//occupied or missing cells around p on its layer
+         blocked += p.x - 1 < 0 || getGrid(p.x - 1, p.y, p.z) != 0;
+         blocked += p.x + 1 >= width || getGrid(p.x + 1, p.y, p.z) != 0;
+         blocked += p.y - 1 < 0 || getGrid(p.x, p.y - 1, p.z) != 0;
+         blocked += p.y + 1 >= height || getGrid(p.x, p.y + 1, p.z) != 0;
+         const float priority = depth + 1 + BF_DISTANCE_WEIGHT * (p - beg).manh() - BF_CONGESTION_WEIGHT * blocked
+            + (planar[k] ? momentum : 1 - momentum) + randFloat(r_gen);
+         nodes.push_back({p, n, depth + 1});
+         heap.push_back({priority, (int)nodes.size() - 1});
+         std::push_heap(heap.begin(), heap.end());
       }
    }
+   return Point(-1,-1,-1);
 }
 
+//marks the edges and vias of a routed path, its cells are already set on the grid
+void Layout::recordPath(const std::vector<int> & path, std::vector<int> & total_path, std::vector<Point> & n_vias){
+   const int plane = width * height;
+   total_path.push_back(path.front());
+   for(size_t i = 1; i < path.size(); ++i){
+      const int curr = path[i], prev = path[i - 1];
+      M_Assert((cellPoint(curr) - cellPoint(prev)).manh() == 1, "path error");
+      const int z = curr / plane;
+      if(z != prev / plane){
+         const Point p = cellPoint(curr);
+         n_vias.push_back(Point(p.x, p.y, std::min(z, prev / plane)));
+      }else{//along the track of layer z, see edges
+         const int track_len = (z & 1) ? height : width;
+         const int r = std::min(curr, prev) - z * plane;
+         edges[z].set(r / track_len, r % track_len);
+         dirty_edges.push_back({{z, r / track_len, r % track_len}});
+      }
+      total_path.push_back(curr);
+   }
+}
 
-void Layout::path2Wire(Net *n, std::vector<Point>& n_vias){
-   n->vias.swap(n_vias);
-   n->wl = n->vias.size();
-   for(int i = 0; i < width; ++i){
-      int beg_idx = -1;
-      for(int j = 0; j < height - 1; ++j){
-         if(!h_edges[i][j]){
-            if(j - beg_idx >= 2){
-               n->v_segments.push_back({i, beg_idx + 1, 1, i + 1, j + 1, 1});
-               n->wl += j - beg_idx -1;
-            }
-            beg_idx = j;
+//union-find over runs of empty cells: a run along the preferred direction of a layer is connected,
+//runs of adjacent layers are joined wherever both cells of a via are empty
+void Layout::labelRegions(){
+   Phase_timer timer(stats.region_time);
+   const int plane = width * height;
+   std::vector<int> & parent = region_stack;
+   parent.clear();
+   region_sizes.clear();
+   for(int z = 0; z < layers; ++z){
+      const int row_len = (z & 1) ? height : width;
+      for(int idx = z * plane, along = 0; idx < (z + 1) * plane; ++idx){
+         if(grids[idx] != 0){
+            regions[idx] = -1;
+         }else if(along > 0 && grids[idx - 1] == 0){
+            regions[idx] = regions[idx - 1];
+            region_sizes.back()++;
+         }else{
+            regions[idx] = parent.size();
+            parent.push_back(parent.size());
+            region_sizes.push_back(1);
          }
-         h_edges[i][j] = false;
+         if(++along == row_len) along = 0;
       }
-      if(height - 1 - beg_idx >= 2){
-         n->v_segments.push_back({i, beg_idx + 1, 1, i + 1, height, 1});
-         n->wl += height - 1 - beg_idx -1;
+   }
+   auto find = [&](int r){
+      while(parent[r] != r){
+         parent[r] = parent[parent[r]];
+         r = parent[r];
+      }
+      return r;
+   };
+   for(int z = 0; z + 1 < layers; ++z){
+      for(int y = 0; y < height; ++y){
+         for(int x = 0; x < width; ++x){
+            const int r1 = regions[cellIndex(x, y, z)], r2 = regions[cellIndex(x, y, z + 1)];
+            if(r1 < 0 || r2 < 0) continue;
+            const int root1 = find(r1), root2 = find(r2);
+            if(root1 == root2) continue;
+            parent[root2] = root1;
+            region_sizes[root1] += region_sizes[root2];
+         }
       }
    }
+   for(int r = 0; r < (int)parent.size(); ++r){
+      parent[r] = find(r);
+   }
+   for(int idx = 0; idx < length; ++idx){
+      if(regions[idx] >= 0) regions[idx] = parent[regions[idx]];//compressed to the root above
+   }
+   regions_valid = true;
+   region_failed_cells = 0;
+}
+
+//rent-or-buy: relabel once the failed searches since the last labeling cost about as much as a labeling,
+//so labeling never takes more than the time lost to failures
+void Layout::searchFailed(long long cells){
+   region_failed_cells += cells;
+   if(region_failed_cells * REGION_LABEL_COST >= (long long)length){
+      labelRegions();
+   }
+}
 
-   for(int i = 0; i < height; ++i){
-      int beg_idx = -1;
-      for(int j = 0; j < width - 1; ++j){
-         if(!v_edges[i][j]){
-            if(j - beg_idx >= 2){
-               n->h_segments.push_back({beg_idx + 1, i, 0, j + 1, i + 1, 0});
-               n->wl += j - beg_idx -1;
-            }
-            beg_idx = j;
+//upper bound of the cells a search starting at p can hold, p included
+int Layout::regionBound(const Point & p) const{
+   const int idx = cellIndex(p.x, p.y, p.z);
+   if(grids[idx] == 0){
+      return regions[idx] >= 0 ? region_sizes[regions[idx]] : INT_MAX;
+   }
+   //start on the net being routed: it can enter every region next to it
+   Point next[4];
+   int next_num = 0;
+   if(p.z % 2){
+      if(p.y - 1 >= 0) next[next_num++] = Point(p.x, p.y - 1, p.z);
+      if(p.y + 1 < height) next[next_num++] = Point(p.x, p.y + 1, p.z);
+   }else{
+      if(p.x - 1 >= 0) next[next_num++] = Point(p.x - 1, p.y, p.z);
+      if(p.x + 1 < width) next[next_num++] = Point(p.x + 1, p.y, p.z);
+   }
+   if(p.z + 1 < layers) next[next_num++] = Point(p.x, p.y, p.z + 1);
+   if(p.z - 1 >= 0) next[next_num++] = Point(p.x, p.y, p.z - 1);
+   int labels[4];
+   int label_num = 0;
+   int bound = 1;
+   for(int k = 0; k < next_num; ++k){
+      const int n_idx = cellIndex(next[k].x, next[k].y, next[k].z);
+      if(grids[n_idx] != 0) continue;
+      const int label = regions[n_idx];
+      if(label < 0) return INT_MAX;
+      if(std::find(labels, labels + label_num, label) != labels + label_num) continue;
+      labels[label_num++] = label;
+      bound += region_sizes[label];
+   }
+   return bound;
+}
+
+void Layout::recoverGridAndEdge(const std::vector<int> & total_path){
+   for(int cell : total_path){
+      setCell(cell, 0);
+   }
+   for(const std::array<int, 3> & e : dirty_edges){
+      edges[e[0]].reset(e[1], e[2]);
+   }
+   dirty_edges.clear();
+}
+
+
+void Layout::path2Wire(Net *n, std::vector<Point>& n_vias){
+   Phase_timer timer(stats.path2wire_time);
+   n->vias.swap(n_vias);
+   n->wl = n->vias.size();
+   //only tracks touched by this net can hold its edges, extract their runs word by word
+   std::sort(dirty_edges.begin(), dirty_edges.end());
+   for(size_t i = 0, j; i < dirty_edges.size(); i = j){
+      const int z = dirty_edges[i][0], track = dirty_edges[i][1];
+      for(j = i + 1; j < dirty_edges.size() && dirty_edges[j][0] == z && dirty_edges[j][1] == track; ++j);
+      BitMatrix & plane = edges[z];
+      const int track_end = dirty_edges[j - 1][2] + 1;
+      for(int beg_idx = plane.nextSet(track, dirty_edges[i][2]); beg_idx < track_end;){
+         const int end_idx = plane.nextClear(track, beg_idx);//one past the last edge of the run
+         if(z & 1){
+            n->v_segments.push_back({{track, beg_idx, z, track + 1, end_idx + 1, z}});
+         }else{
+            n->h_segments.push_back({{beg_idx, track, z, end_idx + 1, track + 1, z}});
          }
-         v_edges[i][j] = false;
-      }
-      if(width - 1 - beg_idx >= 2){
-         n->h_segments.push_back({beg_idx + 1, i, 0, width, i + 1, 0});
-         n->wl += width - 1 - beg_idx -1;
+         n->wl += end_idx - beg_idx;
+         beg_idx = plane.nextSet(track, end_idx);
       }
+      plane.resetRange(track, dirty_edges[i][2], track_end);
    }
+   dirty_edges.clear();
 }
 
-void Layout::saveResult(const std::string & filename){
+bool Layout::saveResult(const std::string & filename, bool write_routing){
+   Phase_timer timer(stats.save_time);
    std::ofstream fout;
 	fout.open(filename, std::ofstream::out);
+	if(!fout.is_open()) return false;
 
-	if (!fout.is_open())
-	{	
-		std::cerr << "Cannot save the result." << std::endl;
-		std::cerr << "Please check." << std::endl;
-		exit(1);
-	}
-
-	fout << "Width 0 " << width << std::endl;
-	fout << "Height 0 " << height << std::endl;
+	fout << "Width 0 " << width << "\n";
+	fout << "Height 0 " << height << "\n";
 
    int total_wl = 0, total_via = 0;
    for(Net * n : nets){
       total_wl += n->wl;
       total_via += n->vias.size();
    }
-	fout << "total_WL " << total_wl << std::endl;
-   fout << "total_via " << total_via << std::endl;;
-	fout << "Layer " << layers << std::endl;
+	fout << "total_WL " << total_wl << "\n";
+   fout << "total_via " << total_via << "\n";
+	fout << "Layer " << layers << "\n";
    for (int i = 0; i < layers; i++) {
-      fout << "track" << i << " 0 1 " << (i % 2) << std::endl;
+      fout << "track" << i << " 0 1 " << (i % 2) << "\n";
    }
-   fout << "Obstacle_num " << obstacles.size() << std::endl;
+   fout << "Obstacle_num " << obstacles.size() << "\n";
    for(std::pair<Point, Point> & p : obstacles){
-		fout << p.first.x << " " << p.first.y << " " << p.first.z << " " << p.second.x << " " << p.second.y << " " << p.second.z << std::endl;
+		fout << p.first.x << " " << p.first.y << " " << p.first.z << " " << p.second.x << " " << p.second.y << " " << p.second.z << "\n";
 	}
-   fout << "Net_num " << nets.size() << std::endl;
+   fout << "Net_num " << nets.size() << "\n";
    for(Net * n : nets){
-      fout << "Net_id " << n->net_id << std::endl;
-      fout << "pin_num " << n->pins.size() << std::endl;
+      fout << "Net_id " << n->net_id << "\n";
+      fout << "pin_num " << n->pins.size() << "\n";
       int pid = 0;
       for(Point & p : n->pins){
-         fout << "pin_id " << pid++ << std::endl;
-         fout << "ap_num 1" << std::endl;
-		   fout << p.x << " " << p.y << " " << p.z << std::endl;
+         fout << "pin_id " << pid++ << "\n";
+         fout << "ap_num 1" << "\n";
+		   fout << p.x << " " << p.y << " " << p.z << "\n";
 	   }
-      fout << "Via_num " << n->vias.size() << std::endl;
+      if(!write_routing) continue;//pins only, as read by the RL env
+      fout << "Via_num " << n->vias.size() << "\n";
       for(Point & p : n->vias){
-         fout << p.x << " " << p.y << std::endl;
+         fout << p.x << " " << p.y << " " << p.z << "\n";
       }
-      fout << "H_segment_num " << n->h_segments.size() << std::endl;
-      for(std::vector<int> & seg : n->h_segments){
-         fout << seg[0] << " " << seg[1] << " " << seg[2] << " " << seg[3] << " " << seg[4] << " " << seg[5] << std::endl;
+      fout << "H_segment_num " << n->h_segments.size() << "\n";
+      for(Segment & seg : n->h_segments){
+         fout << seg[0] << " " << seg[1] << " " << seg[2] << " " << seg[3] << " " << seg[4] << " " << seg[5] << "\n";
       }
-      fout << "V_segment_num " << n->v_segments.size() << std::endl;
-      for(std::vector<int> & seg : n->v_segments){
-         fout << seg[0] << " " << seg[1] << " " << seg[2] << " " << seg[3] << " " << seg[4] << " " << seg[5] << std::endl;
+      fout << "V_segment_num " << n->v_segments.size() << "\n";
+      for(Segment & seg : n->v_segments){
+         fout << seg[0] << " " << seg[1] << " " << seg[2] << " " << seg[3] << " " << seg[4] << " " << seg[5] << "\n";
       }
    }
 
 	fout.close();
+   return !fout.fail();
 }
 
-void Layout::checkLegal(){
-   bool test_grid[width][height][layers];
-   for(int x = 0; x < width; ++x){
-      for(int y = 0; y < height; ++y){
-         for(int z = 0; z < layers; ++z){
-            test_grid[x][y][z] = false;
-         }
+void Layout::serialize(std::vector<int32_t> & record) const{
+   Phase_timer timer(stats.save_time);
+   int total_wl = 0, total_via = 0;
+   size_t pin_total = 0, h_total = 0, v_total = 0;
+   for(const Net * n : nets){
+      total_wl += n->wl;
+      total_via += n->vias.size();
+      pin_total += n->pins.size();
+      h_total += n->h_segments.size();
+      v_total += n->v_segments.size();
+   }
+   record.clear();
+   record.reserve(BINARY_HEADER_WORDS + obstacles.size() * 6 + nets.size() * 6 + (pin_total + total_via) * 3 + (h_total + v_total) * 6);
+   const int32_t header[BINARY_HEADER_WORDS] = {
+      layout_idx, width, height, layers, total_wl, total_via,
+      (int32_t)obstacles.size(), (int32_t)nets.size(), (int32_t)pin_total, total_via, (int32_t)h_total, (int32_t)v_total
+   };
+   record.insert(record.end(), header, header + BINARY_HEADER_WORDS);
+   for(const std::pair<Point, Point> & p : obstacles){
+      const int32_t obs[6] = {p.first.x, p.first.y, p.first.z, p.second.x, p.second.y, p.second.z};
+      record.insert(record.end(), obs, obs + 6);
+   }
+   for(const Net * n : nets){
+      const int32_t net[6] = {(int32_t)n->net_id, n->wl, (int32_t)n->pins.size(), (int32_t)n->vias.size(), (int32_t)n->h_segments.size(), (int32_t)n->v_segments.size()};
+      record.insert(record.end(), net, net + 6);
+   }
+   for(const Net * n : nets){
+      for(const Point & p : n->pins){
+         record.insert(record.end(), {p.x, p.y, p.z});
       }
    }
-   for(Net * n : nets){
-      for(std::vector<int> & seg : n->h_segments){
-         int y = seg[1];
-         int z = seg[2];
-         for(int x = seg[0]; x < seg[3]; ++x){
-            if(test_grid[x][y][z]){
-               std::cerr << "H Error: " << x << " " << y << " " << z << std::endl;
+   for(const Net * n : nets){
+      for(const Point & p : n->vias){
+         record.insert(record.end(), {p.x, p.y, p.z});
+      }
+   }
+   for(const Net * n : nets){
+      for(const Segment & seg : n->h_segments){
+         record.insert(record.end(), seg.begin(), seg.end());
+      }
+   }
+   for(const Net * n : nets){
+      for(const Segment & seg : n->v_segments){
+         record.insert(record.end(), seg.begin(), seg.end());
+      }
+   }
+}
+
+void Layout::snapshot(std::vector<int32_t> & words) const{
+   std::vector<int32_t> record;
+   serialize(record);
+   int32_t magic;
+   memcpy(&magic, SNAPSHOT_MAGIC, 4);
+   words.assign({magic, SNAPSHOT_VERSION});
+   r_gen.save(words);
+   int32_t doubles[4];
+   memcpy(doubles, &budget.success, 8);
+   memcpy(doubles + 2, &budget.cells, 8);
+   words.push_back(budget.nets);
+   words.insert(words.end(), doubles, doubles + 4);
+   //labels are a function of the grid they were computed on: runs of cellIndex ids taken or released since then
+   int32_t failed[2];
+   memcpy(failed, &region_failed_cells, 8);
+   words.insert(words.end(), {regions_valid, failed[0], failed[1], 0});
+   const size_t run_num = words.size() - 1;
+   for(int idx = 0; regions_valid && idx < length; ++idx){
+      if((regions[idx] >= 0) == (grids[idx] == 0)) continue;
+      if(words[run_num] > 0 && words[words.size() - 2] + words.back() == idx){
+         words.back()++;
+      }else{
+         words.insert(words.end(), {idx, 1});
+         words[run_num]++;
+      }
+   }
+   words.insert(words.end(), record.begin(), record.end());
+}
+
+bool Layout::restore(const int32_t * words, size_t size){
+   reset(layout_idx, 0);
+   const int32_t * cur = words, * end = words + size;
+   if(size < 2 || memcmp(cur, SNAPSHOT_MAGIC, 4) != 0 || cur[1] != SNAPSHOT_VERSION) return false;
+   Random_stream stream;
+   if((cur = stream.load(cur + 2, end)) == nullptr || end - cur < 9 + BINARY_HEADER_WORDS) return false;
+   Route_budget saved;
+   saved.nets = cur[0];
+   memcpy(&saved.success, cur + 1, 8);
+   memcpy(&saved.cells, cur + 3, 8);
+   cur += 5;
+   const bool labeled = cur[0];
+   long long failed_cells;
+   memcpy(&failed_cells, cur + 1, 8);
+   const long long run_num = cur[3];
+   const int32_t * runs = cur + 4;
+   if(run_num < 0 || end - runs < 2 * run_num + BINARY_HEADER_WORDS || (!labeled && run_num > 0)) return false;
+   for(long long i = 0, next = 0; i < run_num; next = runs[2 * i] + runs[2 * i + 1], ++i){//disjoint and in order
+      if(runs[2 * i] < next || runs[2 * i + 1] <= 0 || runs[2 * i + 1] > length - runs[2 * i]) return false;
+   }
+   cur = runs + 2 * run_num;
+   //the record of serialize, see writer.h
+   const int32_t * header = cur;
+   if(header[1] != width || header[2] != height || header[3] != layers) return false;
+   const long long obs_num = header[6], net_num = header[7], pin_total = header[8], via_total = header[9], h_total = header[10], v_total = header[11];
+   if(obs_num < 0 || net_num < 0 || pin_total < 0 || via_total < 0 || h_total < 0 || v_total < 0 ||
+      end - cur != BINARY_HEADER_WORDS + 6 * (obs_num + net_num) + 3 * (pin_total + via_total) + 6 * (h_total + v_total)){
+      return false;
+   }
+   auto inDie = [&](const int32_t * p){
+      return p[0] >= 0 && p[0] < width && p[1] >= 0 && p[1] < height && p[2] >= 0 && p[2] < layers;
+   };
+   auto boxInDie = [&](const int32_t * v){//cells [x1, x2) x [y1, y2) x [z1, z2]
+      return v[0] >= 0 && v[0] < v[3] && v[3] <= width && v[1] >= 0 && v[1] < v[4] && v[4] <= height &&
+         v[2] >= 0 && v[2] <= v[5] && v[5] < layers;
+   };
+   const int32_t * obs = header + BINARY_HEADER_WORDS, * net = obs + 6 * obs_num;
+   const int32_t * pin = net + 6 * net_num, * via = pin + 3 * pin_total, * h_seg = via + 3 * via_total, * v_seg = h_seg + 6 * h_total;
+   for(long long i = 0; i < obs_num; ++i, obs += 6){
+      if(!boxInDie(obs) || !isEmpty(Point(obs[0], obs[1], obs[2]), Point(obs[3], obs[4], obs[5]))){
+         reset(layout_idx, 0);
+         return false;
+      }
+      placeObstacle(Point(obs[0], obs[1], obs[2]), Point(obs[3], obs[4], obs[5]));
+   }
+   std::vector<Point> & pins = route_pins, & vias = route_vias;
+   std::vector<Segment> h_segments, v_segments;
+   long long pins_left = pin_total, vias_left = via_total, h_left = h_total, v_left = v_total;
+   for(long long i = 0; i < net_num; ++i, net += 6){
+      if(net[2] < 0 || net[3] < 0 || net[4] < 0 || net[5] < 0 ||
+         (pins_left -= net[2]) < 0 || (vias_left -= net[3]) < 0 || (h_left -= net[4]) < 0 || (v_left -= net[5]) < 0){
+         reset(layout_idx, 0);
+         return false;
+      }
+      bool valid = true;
+      pins.clear();
+      for(int k = 0; k < net[2]; ++k, pin += 3){
+         valid &= inDie(pin);
+         pins.push_back(Point(pin[0], pin[1], pin[2]));
+      }
+      vias.clear();
+      for(int k = 0; k < net[3]; ++k, via += 3){
+         valid &= inDie(via) && via[2] + 1 < layers;
+         vias.push_back(Point(via[0], via[1], via[2]));
+      }
+      h_segments.clear();
+      for(int k = 0; k < net[4]; ++k, h_seg += 6){
+         valid &= boxInDie(h_seg);
+         h_segments.push_back({{h_seg[0], h_seg[1], h_seg[2], h_seg[3], h_seg[4], h_seg[5]}});
+      }
+      v_segments.clear();
+      for(int k = 0; k < net[5]; ++k, v_seg += 6){
+         valid &= boxInDie(v_seg);
+         v_segments.push_back({{v_seg[0], v_seg[1], v_seg[2], v_seg[3], v_seg[4], v_seg[5]}});
+      }
+      //every cell of the net must be empty or already its own: no obstacle or other net under it
+      resetVisited();
+      auto claim = [&](int x, int y, int z){
+         const int idx = cellIndex(x, y, z);
+         valid &= grids[idx] == 0 || getVisited(idx);
+         setVisited(idx);
+      };
+      for(int vertical = 0; valid && vertical < 2; ++vertical){
+         for(const Segment & seg : vertical ? v_segments : h_segments){
+            for(int z = seg[2]; z <= seg[5]; ++z){
+               for(int x = seg[0]; x < seg[3]; ++x){
+                  for(int y = seg[1]; y < seg[4]; ++y){
+                     claim(x, y, z);
+                  }
+               }
             }
-            test_grid[x][y][z] = true;
          }
       }
-      for(std::vector<int> & seg : n->v_segments){
-         int x = seg[0];
-         int z = seg[2];
-         for(int y = seg[1]; y< seg[4]; ++y){
-            if(test_grid[x][y][z]){
-               std::cerr << "V Error: " << x << " " << y << " " << z << std::endl;
-            }
-            test_grid[x][y][z] = true;
+      for(const Point & p : vias){
+         if(valid){
+            claim(p.x, p.y, p.z);
+            claim(p.x, p.y, p.z + 1);
          }
       }
-      for(Point & p : n->pins){
-         test_grid[p.x][p.y][p.z] = true;
+      for(const Point & p : pins){
+         if(valid) claim(p.x, p.y, p.z);
+      }
+      if(!valid){
+         reset(layout_idx, 0);
+         return false;
+      }
+      loadNet(net[0], pins, vias, h_segments, v_segments);
+   }
+   if(labeled){//label the grid of the last labeling, then take and release the cells changed since, as setCell did
+      std::vector<int8_t> changed;
+      for(long long i = 0; i < run_num; ++i){
+         for(int idx = runs[2 * i]; idx < runs[2 * i] + runs[2 * i + 1]; ++idx){
+            changed.push_back(grids[idx]);
+            grids[idx] = grids[idx] == 0 ? 1 : 0;
+         }
+      }
+      labelRegions();
+      for(long long i = 0, k = 0; i < run_num; ++i){
+         for(int idx = runs[2 * i]; idx < runs[2 * i] + runs[2 * i + 1]; ++idx){
+            setCell(idx, changed[k++]);
+         }
       }
    }
+   region_failed_cells = failed_cells;
+   layout_idx = header[0];
+   r_gen = stream;
+   budget = saved;
+   return true;
+}
+
+bool Layout::saveSnapshot(const std::string & filename) const{
+   std::vector<int32_t> words;
+   snapshot(words);
+   FILE * fout = fopen(filename.c_str(), "wb");
+   if(fout == nullptr) return false;
+   const bool written = fwrite(words.data(), sizeof(int32_t), words.size(), fout) == words.size();
+   return (fclose(fout) == 0) && written;
+}
+
+bool Layout::loadSnapshot(const std::string & filename){
+   std::ifstream fin(filename, std::ios::binary | std::ios::ate);
+   if(!fin.is_open()) return false;
+   const std::streamoff bytes = fin.tellg();
+   if(bytes < 0 || bytes % sizeof(int32_t)) return false;
+   std::vector<int32_t> words(bytes / sizeof(int32_t));
+   fin.seekg(0);
+   if(!fin.read(reinterpret_cast<char *>(words.data()), bytes)) return false;
+   return restore(words.data(), words.size());
+}
+
+bool Layout::checkLegal(){
+   Verifier verifier(width, height, layers);
+   const Verify_result result = verifier.verify(*this);
+   if(!result.legal()) result.print(std::cerr);
+   return result.legal();
 }
\ No newline at end of file
@@ -10,45 +10,99 @@
 #include <set>
 #include <algorithm>
 #include <cstring>
+#include <cstdint>
+#include <climits>
 #include <fstream>
 #include <stack>
+#include <deque>
+#include <memory>
 #include "point.h"
 #include "net.h"
 #include "assert.h"
 #include "net_config.h"
 #include "debugger.h"
+#include "bitmatrix.h"
+#include "writer.h"
+#include "profiler.h"
+#include "track_index.h"
+#include "rng.h"
 
-inline int randInt(std::mt19937 & generator, int min, int max){
-   std::uniform_int_distribution<int> distribution(min, max);
-   return distribution(generator);
+#define ROUTE_BATCH_PER_THREAD 2  // default nets per batch and thread of generateNetsParallel
+#define BUDGET_WINDOW 32  // nets averaged by the reroute budget, and routed before it may stop a case
+#define BUDGET_MIN_SUCCESS 1e-3  // success rate floor of the net cost estimate
+#define BUDGET_COST_LIMIT 16  // cost_limit of autoConfig, in nets of pin_num pins searched up to wl_limit
+#define FREE_DRAW_TRIES 64  // random bottom-layer cells tried for an empty one before a start is drawn by rank
+#define SNAPSHOT_MAGIC "LSNP"
+#define SNAPSHOT_VERSION 2
+
+inline int randInt(Random_stream & generator, int min, int max){
+   return generator.range(min, max);
 }
 
-inline int randIntNorm(std::mt19937 & generator, int min, int max) {
+inline int randIntNorm(Random_stream & generator, int min, int max) {
    std::normal_distribution<float> distribution(0, float(max - min) / 3);
    return std::round(min + std::abs(distribution(generator)));
 }
 
-inline float randFloat(std::mt19937 & generator, float min = 0.0, float max = 1.0){
-   std::uniform_real_distribution<float> distribution(min, max);
-   return distribution(generator);
+inline float randFloat(Random_stream & generator, float min = 0.0, float max = 1.0){
+   return generator.uniform(min, max);
+}
+
+//seed of one case attempt, a pure function of its coordinates so output doesn't depend on threads or shards
+inline uint64_t caseSeed(uint64_t seed, int level, int idx, int attempt){
+   uint64_t h = splitMix64(seed);
+   h = splitMix64(h ^ (uint32_t)level);
+   h = splitMix64(h ^ (uint32_t)idx);
+   return splitMix64(h ^ (uint32_t)attempt);
 }
 
 class Layout{
 public:
    Layout(int _width, int _height, int _layers, int idx);
+   Layout(int _width, int _height, int _layers, int idx, uint64_t seed, Random_engine engine = XOSHIRO_ENGINE);
    ~Layout();
+
+   void reset(int idx, uint64_t seed);//start a new case, reuses all storage allocated by previous cases
    
    void autoConfig(std::vector<std::pair<int, Net_config>> & net_configs, int net_num, int pin_num);
    void generateObstacles(const std::vector<int> & obs_num, const std::vector<std::pair<int,int>> & obs_size_range);
    bool addObstacle(Point & p1, Point & p2);
-   int generateNets(const std::vector<std::pair<int, Net_config>> & net_configs);
+   int generateNets(const std::vector<std::pair<int, Net_config>> & net_configs, std::ostream & log = std::cout);
+   //route up to batch nets at once on threads shadow copies of the grid, committed in slot order (see generateNetsParallel),
+   //a case is a pure function of its seed, threads and batch. threads 1 routes one net at a time on the grid (default)
+   void setRouteThreads(int threads, int batch = 0);
+   void setRandomEngine(Random_engine engine){ r_gen.setEngine(engine); }//from the next reset, see rng.h
+   void reseed(uint64_t seed){ r_gen.seed(seed); }//new draws for the same obstacles and nets, e.g. after a restore
    bool generateNet(const Net_config & config);
-   void saveResult(const std::string & filename);
-   void checkLegal();
+   //appends a routed net read back from a case (see case_reader.h): pin cells become 2, via and segment cells 1,
+   //wl is recomputed from the vias and segment edges. Coordinates must be in the die, legality is left to a Verifier
+   Net * loadNet(int id, const std::vector<Point> & pins, const std::vector<Point> & vias,
+      const std::vector<Segment> & h_segments, const std::vector<Segment> & v_segments);
+   bool saveResult(const std::string & filename, bool write_routing = true);//false if the file can't be written
+   void serialize(std::vector<int32_t> & record) const;//one record of the binary container, see writer.h
+   bool checkLegal();//one-off Verifier pass printing the violations, see verifier.h
+   /**
+    * Snapshot of everything a case continues from, as int32 words:
+    *    "LSNP" <version> <random stream (see Random_stream::save)> <reroute budget: nets success cells>
+    *    <region labels: valid failed_cells run_num, <first length> per run of cells taken or released since the last labeling>
+    *    <the record of serialize: case id, die, obstacles and nets>
+    * The grid, the free-cell count and the obstacle tracks are rebuilt by restore from the obstacles and nets,
+    * the region labels by labeling the grid of the last labeling again, so this layout and every layout restored
+    * from the snapshot go on generating the same obstacles and nets.
+    */
+   void snapshot(std::vector<int32_t> & words) const;
+   bool restore(const int32_t * words, size_t size);//false if malformed, of another die or with a net over an obstacle or another net, the layout is left reset
+   bool saveSnapshot(const std::string & filename) const;
+   bool loadSnapshot(const std::string & filename);
+
+   int getWidth() const{ return width; }
+   int getHeight() const{ return height; }
+   int getLayers() const{ return layers; }
 
    std::vector<Net *> nets;
    std::vector<std::pair<Point, Point>>obstacles;
-   const int layout_idx;
+   int layout_idx;
+   mutable Layout_stats stats;//accumulated over every case generated by this layout, serialize times itself
 protected:
    void archiveAndReset();//free memory and only keep net pins result, after this function is called, net can't be generated anymore
    const int width;
@@ -56,36 +110,149 @@ protected:
    const int layers;
    const int length;
 private:
-   inline void setGrid(int x, int y, int z, int value){
+   //one plane per layer, rows follow the preferred direction: y * width + x on horizontal (even) layers, x * height + y on vertical (odd) layers
+   inline int cellIndex(int x, int y, int z) const{
       M_Assert(x >= 0 && x < width && y >= 0 && y < height && z >= 0 && z < layers, "out of range");
-      grids[x * height * layers + y * layers + z] = value;
+      return z * width * height + ((z & 1) ? x * height + y : y * width + x);
+   }
+   inline Point cellPoint(int idx) const{//inverse of cellIndex
+      const int plane = width * height;
+      const int z = idx / plane, r = idx - z * plane;
+      return (z & 1) ? Point(r / height, r % height, z) : Point(r % width, r / width, z);
+   }
+   inline void setGrid(int x, int y, int z, int value){
+      setCell(cellIndex(x, y, z), value);
+   }
+   inline void setCell(int idx, int value){
+      int8_t & grid = grids[idx];
+      if((grid == 0) != (value == 0)){
+         if(idx < width * height && free_count_valid){//keep the free-cell count in sync, cellIndex(x, y, 0) == y * width + x
+            free_count += (value == 0) ? 1 : -1;
+         }
+         if(regions_valid && regions[idx] >= 0){//keep the region size bounds in sync
+            region_sizes[regions[idx]] += (value == 0) ? 1 : -1;
+         }
+      }
+      grid = value;
    }
    inline int getGrid(int x, int y, int z) const{
-      M_Assert(x >= 0 && x < width && y >= 0 && y < height && z >= 0 && z < layers, "out of range");
-      return grids[x * height * layers + y * layers + z];
+      return grids[cellIndex(x, y, z)];
    }
-   inline void setVisited(int x, int y, int z){
-      M_Assert(x >= 0 && x < width && y >= 0 && y < height && z >= 0 && z < layers, "out of range");
-      visited[x * height * layers + y * layers + z] = true;
+   inline void setVisited(int idx){
+      visited[idx] = visit_epoch;
    }
-   inline bool getVisited(int x, int y, int z) const{
-      M_Assert(x >= 0 && x < width && y >= 0 && y < height && z >= 0 && z < layers, "out of range");
-      return visited[x * height * layers + y * layers + z];
+   inline bool getVisited(int idx) const{
+      return visited[idx] == visit_epoch;
    }
-   inline void resetVisited(){
-      memset(visited, 0, sizeof(bool) * length);
+   inline void resetVisited(){//start a new epoch, only clear the stamps when the counter wraps around
+      if(++visit_epoch == 0){
+         std::fill(visited.begin(), visited.end(), 0);
+         visit_epoch = 1;
+      }
    }
 
-   Point searchEngine(const Point & beg, size_t wl_lower_bound, size_t wl_upper_bound, float momentum, std::vector<Point> & total_path, std::vector<Point> & n_vias);
+   inline Point search(const Net_config & config, const Point & beg, size_t wl_lower_bound, float momentum, std::vector<int> & total_path, std::vector<Point> & n_vias){
+      if(config.engine == BEST_FIRST_ENGINE){
+         return searchEngineBestFirst(beg, wl_lower_bound, config.wl_limit, momentum, total_path, n_vias);
+      }
+      return searchEngine(beg, wl_lower_bound, config.wl_limit, momentum, total_path, n_vias);
+   }
+   int generateNetsParallel(const std::vector<std::pair<int, Net_config>> & net_configs, std::ostream & log);
+   void syncShadow(const Layout & master);
+   Point searchEngine(const Point & beg, size_t wl_lower_bound, size_t wl_upper_bound, float momentum, std::vector<int> & total_path, std::vector<Point> & n_vias);
+   Point searchEngineBestFirst(const Point & beg, size_t wl_lower_bound, size_t wl_upper_bound, float momentum, std::vector<int> & total_path, std::vector<Point> & n_vias);
+   void recordPath(const std::vector<int> & path, std::vector<int> & total_path, std::vector<Point> & n_vias);
+   bool overBudget(const Net_config & config) const;
+   void labelRegions();
+   void searchFailed(long long cells);
+   int regionBound(const Point & p) const;
    void path2Wire(Net * n, std::vector<Point>& n_vias);
-   void recoverGridAndEdge(const std::vector<Point> & total_path);
+   void recoverGridAndEdge(const std::vector<int> & total_path);
+   Net * allocNet(int id, const std::vector<Point> & pins);
+   void countFreeCells();
+   int drawFreeCell();
+   bool isEmpty(const Point & p1, const Point & p2) const;
+   void placeObstacle(const Point & p1, const Point & p2);
 
    
-   std::mt19937 r_gen;
-   int * grids; //-1: obstacle, 0: empty, 1: net 2: pin
-   std::vector<std::vector<bool>> h_edges;
-   std::vector<std::vector<bool>> v_edges;
-   bool * visited;
+   Random_stream r_gen;
+   std::vector<int8_t> grids; //-1: obstacle, 0: empty, 1: net 2: pin, indexed by cellIndex
+   //one plane per layer, edges[z][track][pos]: edge between cells pos and pos + 1 of a track,
+   //tracks are rows (y) on horizontal (even) layers and columns (x) on vertical (odd) layers
+   std::vector<BitMatrix> edges;
+   std::vector<std::array<int, 3>> dirty_edges;//(z, track, pos) of edges set by the net being routed
+   std::vector<uint32_t> visited;//epoch of the last search that visited each cell
+   uint32_t visit_epoch;
+   int free_count;//empty cells at the bottom layer, starts are drawn from the grid itself, see drawFreeCell
+   bool free_count_valid;//counted by the first net of a case, obstacles don't maintain it one cell at a time
+   //connected regions of empty cells on the routing layers under the preferred-direction rules,
+   //(re)labeled once failed searches expanded as many cells as a labeling costs, the sizes stay upper bounds in between
+   std::vector<int> regions;//region of each cell empty at the last labeling, -1 otherwise
+   std::vector<int> region_sizes;//empty cells left in each region, an upper bound once nets split it
+   std::vector<int> region_stack;//union-find parents of labelRegions
+   bool regions_valid;
+   long long region_failed_cells;//cells expanded by failed searches since the last labeling
+
+   std::vector<TrackIndex> obstacle_tracks;//obstacle intervals of every layer
+   std::vector<long long> obstacle_starts;//scratch of generateObstacles
+
+   std::deque<Net> net_arena;//owns every net, entries are reused across cases
+   size_t net_used;
+   //scratch buffers of generateNet & searchEngine, kept to reuse their capacity.
+   //cells are cellIndex ids, turned back into Points only for the vias and segments of a net
+   std::vector<int> route_path;
+   std::vector<Point> route_vias;
+   std::vector<Point> route_pins;
+   std::vector<int> route_starts;
+   std::vector<int> search_path;
+   std::vector<std::pair<int, int>> search_candidates;//(next cell, previous cell)
+   struct Search_node{
+      Point p;
+      int parent;//index in search_nodes, -1 for the start
+      int depth;//cells from the start, start included
+   };
+   std::vector<Search_node> search_nodes;
+   std::vector<std::pair<float, int>> search_heap;//(priority, node), max-heap
+
+   //adaptive reroute budget of the case: running averages over its recent generateNet calls,
+   //whole nets rather than searches, a net failing on its last pin wastes the searches of the others
+   struct Route_budget{
+      double success;//rate of created nets
+      double cells;//cells expanded per net, created or not
+      long long nets;
+      void clear(){
+         success = 1;
+         cells = 0;
+         nets = 0;
+      }
+      void record(bool created, long long spent){//a plain mean over the first BUDGET_WINDOW nets, then an EWMA
+         const double alpha = std::max(1.0 / ++nets, 1.0 / BUDGET_WINDOW);
+         success += alpha * (created - success);
+         cells += alpha * (spent - cells);
+      }
+      double netCost() const{//cells expected to be expanded until one more net is created
+         return cells / std::max(success, BUDGET_MIN_SUCCESS);
+      }
+   };
+   Route_budget budget;
+   long long route_spent;//cells expanded by the last generateNet
+   bool route_abandoned;//the last generateNet gave up past the cost_limit of its config
+
+   //speculative routing of generateNetsParallel: slot k of a batch is routed on shadow k % route_threads
+   struct Route_slot{
+      const Net_config * config;
+      uint64_t seed;
+      bool routed;
+      int shadow_net;//index in the shadow's nets
+      std::vector<int> cells;//cells taken by the net on the shadow
+      long long spent;//cells expanded by the net, recorded into the budget of the case in slot order
+      bool abandoned;//given up past the cost_limit, not a conflict: not routed again
+   };
+   int route_threads;
+   int route_batch;
+   std::vector<std::unique_ptr<Layout>> route_shadows;
+   std::vector<Route_slot> route_slots;
+   std::vector<std::pair<int, int>> route_log;//(cell, value) written by the commits of the current batch
 };
 
 #endif
\ No newline at end of file
@@ -1,4 +1,9 @@
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <memory>
 #include <stdlib.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -6,54 +11,277 @@
 
 #include "net_config.h"
 #include "layout.h"
+#include "scheduler.h"
+#include "manifest.h"
+#include "verifier.h"
 
 #define ARGN 10
 /**
- * ./main <dir>
+ * ./main [--threads N] [--seed S] [--level L] [--format text|binary] [--env-dir DIR] [--id-offset N] [--shard K/N] [--engine dfs|best-first] [--verify] [--rng xoshiro|mt19937]
+ *        [--route-threads N] [--route-batch B] [--cost-limit C] [--snapshot-out DIR] [--snapshot-in DIR] <dir>
  * <test_num>
  * <width> <height> <layers>
  * <obs_num> <min_obs_size> <max_obs_size>
  * <net_num> <pin_num>
- * 
+ *
  * ./main 'dir' 10 50 50 3 4 3 10 4 2
+ *
+ * --threads N: number of worker threads (0 = all cores, default 1)
+ * --seed S --level L: case i is a pure function of (S, L, i), whatever the thread count (default S: current time, printed)
+ * --format text|binary: one <i>.txt per case (default) or every case in <dir>/cases.bin
+ * --env-dir DIR: also write the pins-only case for the RL env to DIR/id_<id-offset + i>.txt
+ * --shard K/N: only generate the cases i with i % N == K (default 0/1)
+ * --engine dfs|best-first: search engine routing the nets (default dfs, see Search_engine)
+ * --route-threads N --route-batch B: route the nets of a case speculatively on N threads, B nets at a time
+ *           (default 1: one net at a time, B defaults to 2N, see Layout::generateNetsParallel), for a few large dies
+ * --rng xoshiro|mt19937: random engine (default xoshiro, see rng.h), mt19937 uses std::mt19937 through the std distributions, for callers who want that engine
+ * --cost-limit C: stop adding nets to a case once one more is expected to expand more than C cells, and abandon a net
+ *           past C cells (default: 16 nets of <pin_num> pins searched up to the wl limit, 0: no limit, see Layout::overBudget)
+ * --snapshot-out DIR: also write the state of every finished case to DIR/<i>.snap (see Layout::snapshot)
+ * --snapshot-in DIR: start case i from DIR/<i>.snap instead of an empty die: its obstacles and nets are kept
+ *           (<obs_num> and the obstacle sizes are ignored) and <net_num> more nets are added, continuing its random stream,
+ *           a retried attempt draws from caseSeed instead. The cases keep the random engine of their snapshots
+ * --verify: check every case with a Verifier before writing it, an illegal case is reported and generated again
+ *           with the next attempt (always on in checked builds)
+ *
+ * Finished ids are recorded in <dir>/manifest.txt (manifest_K_N.txt, cases_K_N.bin for a shard of N > 1),
+ * rerunning the same command skips them and only generates the missing cases.
  */
 int main(int argc, char *argv[]){
-    M_Assert(argc == (ARGN + 1), "check main.cpp for args");
-    int index = 0;
-    const char* directory = argv[++index];
-    const int test_num = atoi(argv[++index]);
-    const int width = atoi(argv[++index]);
-    const int height = atoi(argv[++index]);
-    const int layers = atoi(argv[++index]);
-    const int obs_num = atoi(argv[++index]);
-    const int min_obs_size = atoi(argv[++index]);
-    const int max_obs_size = atoi(argv[++index]);
-    const int net_num = atoi(argv[++index]);
-    const int pin_num = atoi(argv[++index]);
+    int thread_num = 1;
+    uint64_t seed = time(0);
+    bool seed_given = false;
+    int level = 0;
+    bool binary = false;
+    const char* env_directory = nullptr;
+    int id_offset = 0;
+    int shard = 0, shard_num = 1;
+    Search_engine engine = DFS_ENGINE;
+#ifdef DEBUG
+    bool verify = true;
+#else
+    bool verify = false;
+#endif
+    int route_threads = 1, route_batch = 0;
+    long long cost_limit = -1;  // autoConfig's
+    const char* snapshot_out = nullptr;
+    const char* snapshot_in = nullptr;
+    Random_engine rng = XOSHIRO_ENGINE;
+    std::vector<char *> args;
+    for(int i = 1; i < argc; ++i){
+        std::string arg(argv[i]);
+        if(arg == "--threads" && i + 1 < argc){
+            thread_num = atoi(argv[++i]);
+        }else if(arg == "--seed" && i + 1 < argc){
+            seed = strtoull(argv[++i], nullptr, 10);
+            seed_given = true;
+        }else if(arg == "--level" && i + 1 < argc){
+            level = atoi(argv[++i]);
+        }else if(arg == "--env-dir" && i + 1 < argc){
+            env_directory = argv[++i];
+        }else if(arg == "--id-offset" && i + 1 < argc){
+            id_offset = atoi(argv[++i]);
+        }else if(arg == "--format" && i + 1 < argc){
+            std::string format(argv[++i]);
+            if(format != "text" && format != "binary"){
+                std::cerr << "--format must be text or binary" << std::endl;
+                return 1;
+            }
+            binary = (format == "binary");
+        }else if(arg == "--engine" && i + 1 < argc){
+            std::string name(argv[++i]);
+            if(name != "dfs" && name != "best-first"){
+                std::cerr << "--engine must be dfs or best-first" << std::endl;
+                return 1;
+            }
+            engine = (name == "best-first") ? BEST_FIRST_ENGINE : DFS_ENGINE;
+        }else if(arg == "--route-threads" && i + 1 < argc){
+            route_threads = std::max(1, atoi(argv[++i]));
+        }else if(arg == "--route-batch" && i + 1 < argc){
+            route_batch = atoi(argv[++i]);
+        }else if(arg == "--cost-limit" && i + 1 < argc){
+            cost_limit = std::max(0LL, atoll(argv[++i]));
+        }else if(arg == "--rng" && i + 1 < argc){
+            std::string name(argv[++i]);
+            if(name != "xoshiro" && name != "mt19937"){
+                std::cerr << "--rng must be xoshiro or mt19937" << std::endl;
+                return 1;
+            }
+            rng = (name == "mt19937") ? MT19937_ENGINE : XOSHIRO_ENGINE;
+        }else if(arg == "--snapshot-out" && i + 1 < argc){
+            snapshot_out = argv[++i];
+        }else if(arg == "--snapshot-in" && i + 1 < argc){
+            snapshot_in = argv[++i];
+        }else if(arg == "--verify"){
+            verify = true;
+        }else if(arg == "--shard" && i + 1 < argc){
+            if(sscanf(argv[++i], "%d/%d", &shard, &shard_num) != 2 || shard < 0 || shard >= shard_num){
+                std::cerr << "--shard must be K/N with 0 <= K < N" << std::endl;
+                return 1;
+            }
+        }else{
+            args.push_back(argv[i]);
+        }
+    }
+    if(args.size() != ARGN){
+        std::cerr << "check main.cpp for args" << std::endl;
+        return 1;
+    }
+    int index = -1;
+    const char* directory = args[++index];
+    const int test_num = atoi(args[++index]);
+    const int width = atoi(args[++index]);
+    const int height = atoi(args[++index]);
+    const int layers = atoi(args[++index]);
+    const int obs_num = atoi(args[++index]);
+    const int min_obs_size = atoi(args[++index]);
+    const int max_obs_size = atoi(args[++index]);
+    const int net_num = atoi(args[++index]);
+    const int pin_num = atoi(args[++index]);
+    if(!seed_given) std::cerr << "seed " << seed << std::endl;
 
     struct stat st = {0};
     if (stat(directory, &st) == -1) mkdir(directory, 0700);
+    if (env_directory && stat(env_directory, &st) == -1) mkdir(env_directory, 0700);
+    if (snapshot_out && stat(snapshot_out, &st) == -1) mkdir(snapshot_out, 0700);
+
+    const std::string suffix = shard_num > 1 ? "_" + std::to_string(shard) + "_" + std::to_string(shard_num) : "";
+    std::ostringstream header;
+    header << "seed " << seed << "\n"
+        << "level " << level << "\n"
+        << "shard " << shard << " " << shard_num << "\n"
+        << "format " << (binary ? "binary" : "text") << "\n"
+        << "engine " << (engine == BEST_FIRST_ENGINE ? "best-first" : "dfs") << "\n"
+        << "params";
+    for(int j = 1; j < ARGN; ++j){
+        header << " " << atoi(args[j]);
+    }
+    header << "\n";
+    route_batch = route_batch > 0 ? std::max(route_batch, route_threads) : route_threads * ROUTE_BATCH_PER_THREAD;
+    header << "rng " << (rng == MT19937_ENGINE ? "mt19937" : "xoshiro") << "\n";
+    if(route_threads > 1){  // only written when used, manifests of one-net-at-a-time runs stay valid
+        header << "route " << route_threads << " " << route_batch << "\n";
+    }
+    if(cost_limit >= 0){  // only written when given, the default follows the parameters
+        header << "cost_limit " << cost_limit << "\n";
+    }
+    if(snapshot_in){  // the cases continue these snapshots
+        header << "snapshot_in " << snapshot_in << "\n";
+    }
+    Manifest manifest(std::string(directory) + "/manifest" + suffix + ".txt", header.str());
 
-    for(int i = 0; i < test_num; ++i){
-        std::vector<std::pair<int, Net_config>> net_configs;
-        Layout L(width, height, layers, i);
-        std::vector<int> obs_nums(layers, obs_num / layers);
-        for (int j = 0; j < (obs_num % layers); j++) obs_nums[j]++;
-        L.generateObstacles(
-            obs_nums, 
-            std::vector<std::pair<int, int>>(layers, {min_obs_size, max_obs_size})
-        );
-        L.autoConfig(net_configs, net_num, pin_num);
-        int total_nets = L.generateNets(net_configs);
-        if (total_nets == 0) {  // no net created, retry
-            i--;
-            continue;
+    std::unique_ptr<BinaryWriter> writer;
+    std::vector<bool> done(test_num, false);
+    if(binary){
+        // the container is the ground truth: the manifest may list records still buffered at a crash
+        const std::string bin_name = std::string(directory) + "/cases" + suffix + ".bin";
+        for(int id : BinaryWriter::recover(bin_name)){
+            if(id < 0 || id >= test_num) continue;
+            done[id] = true;
+            if(!manifest.isDone(id)) manifest.markDone(id);
         }
-#ifdef DEBUG
-        L.checkLegal();
-#endif
-        std::string file_name = std::string(directory) + "/" + std::to_string(i) + ".txt";
-        L.saveResult(file_name);
+        writer.reset(new BinaryWriter(bin_name, 1 << 20, true));
+    }else{
+        for(int i = 0; i < test_num; ++i){
+            done[i] = manifest.isDone(i);
+        }
+    }
+    std::vector<int> tasks;
+    for(int i = shard; i < test_num; i += shard_num){
+        if(!done[i]) tasks.push_back(i);
+    }
+    const int shard_size = std::max(0, (test_num - shard + shard_num - 1) / shard_num);
+    if((int)tasks.size() < shard_size){
+        std::cerr << "resume: " << shard_size - tasks.size() << " of " << shard_size << " cases already done" << std::endl;
+    }
+    if(thread_num <= 0) thread_num = std::max(1u, std::thread::hardware_concurrency());
+    thread_num = std::max(1, std::min<int>(thread_num, tasks.size()));
+    // cores left over by the case workers check the nets of a case in parallel
+    const int verify_threads = std::max(1u, std::thread::hardware_concurrency() / thread_num);
+
+    Scheduler scheduler(tasks, thread_num);
+    std::mutex log_lock;
+    auto worker = [&](int w){
+        std::ostringstream log;
+        std::vector<int32_t> record;
+        Layout L(width, height, layers, 0, 0, rng);  // allocated once, reset for every case
+        L.setRouteThreads(route_threads, route_batch);
+        std::unique_ptr<Verifier> verifier(verify ? new Verifier(width, height, layers, verify_threads) : nullptr);
+        int i;
+        while(scheduler.next(w, i)){
+            for(int attempt = 0; ; ++attempt){  // no net created, retry with the same index
+                std::vector<std::pair<int, Net_config>> net_configs;
+                if(snapshot_in){
+                    const std::string snap_name = std::string(snapshot_in) + "/" + std::to_string(i) + ".snap";
+                    if(!L.loadSnapshot(snap_name)){
+                        std::cerr << "Cannot restore " << snap_name << "." << std::endl;
+                        exit(1);
+                    }
+                    if(attempt > 0) L.reseed(caseSeed(seed, level, i, attempt));
+                }else{
+                    L.reset(i, caseSeed(seed, level, i, attempt));
+                    std::vector<int> obs_nums(layers, obs_num / layers);
+                    for (int j = 0; j < (obs_num % layers); j++) obs_nums[j]++;
+                    L.generateObstacles(
+                        obs_nums,
+                        std::vector<std::pair<int, int>>(layers, {min_obs_size, max_obs_size})
+                    );
+                }
+                L.autoConfig(net_configs, net_num, pin_num);
+                for(std::pair<int, Net_config> & c : net_configs){
+                    c.second.engine = engine;
+                    if(cost_limit >= 0) c.second.cost_limit = cost_limit;
+                }
+                L.generateNets(net_configs, log);
+                if (L.nets.empty()) continue;
+                if(verifier){
+                    const Verify_result result = verifier->verify(L);
+                    if(!result.legal()){
+                        std::lock_guard<std::mutex> guard(log_lock);
+                        std::cerr << "case " << i << " attempt " << attempt << " ";
+                        result.print(std::cerr);
+                        continue;
+                    }
+                }
+                if(snapshot_out){
+                    const std::string snap_name = std::string(snapshot_out) + "/" + std::to_string(i) + ".snap";
+                    if(!L.saveSnapshot(snap_name)){
+                        std::cerr << "Cannot save " << snap_name << "." << std::endl;
+                        exit(1);
+                    }
+                }
+                if(binary){
+                    L.serialize(record);
+                    writer->write(record);
+                }else{
+                    std::string file_name = std::string(directory) + "/" + std::to_string(i) + ".txt";
+                    if(!L.saveResult(file_name)){
+                        std::cerr << "Cannot save " << file_name << "." << std::endl;
+                        exit(1);
+                    }
+                }
+                if(env_directory){
+                    std::string env_name = std::string(env_directory) + "/id_" + std::to_string(id_offset + i) + ".txt";
+                    if(!L.saveResult(env_name, false)){
+                        std::cerr << "Cannot save " << env_name << "." << std::endl;
+                        exit(1);
+                    }
+                }
+                manifest.markDone(i);
+                break;
+            }
+            std::lock_guard<std::mutex> guard(log_lock);
+            std::cout << log.str();
+            log.str("");
+        }
+    };
+    std::vector<std::thread> workers;
+    for(int w = 1; w < thread_num; ++w){
+        workers.emplace_back(worker, w);
+    }
+    worker(0);
+    for(std::thread & t : workers){
+        t.join();
     }
     return 0;
-}
\ No newline at end of file
+}
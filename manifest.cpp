@@ -0,0 +1,48 @@
+#include "manifest.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+
+Manifest::Manifest(const std::string & filename, const std::string & header){
+   std::string content;
+   std::ifstream fin(filename);
+   if(fin) content.assign(std::istreambuf_iterator<char>(fin), std::istreambuf_iterator<char>());
+   bool partial = false;
+   if(content.size()){
+      if(content.compare(0, header.size(), header) != 0){
+         std::cerr << filename << " was written by a run with other parameters." << std::endl;
+         std::cerr << "Please use another directory or remove it." << std::endl;
+         exit(1);
+      }
+      size_t beg = header.size(), end;
+      while((end = content.find('\n', beg)) != std::string::npos){//a line cut by a crash has no '\n' and is ignored
+         std::istringstream line(content.substr(beg, end - beg));
+         std::string key;
+         int id;
+         if(line >> key >> id && key == "done") done.insert(id);
+         beg = end + 1;
+      }
+      partial = beg < content.size();
+   }
+   fout = fopen(filename.c_str(), "a");
+   if(fout == nullptr){
+      std::cerr << "Cannot save the manifest." << std::endl;
+      std::cerr << "Please check." << std::endl;
+      exit(1);
+   }
+   if(content.empty()) fputs(header.c_str(), fout);
+   if(partial) fputc('\n', fout);
+   fflush(fout);
+}
+
+Manifest::~Manifest(){
+   fclose(fout);
+}
+
+void Manifest::markDone(int id){
+   std::lock_guard<std::mutex> guard(lock);
+   done.insert(id);
+   fprintf(fout, "done %d\n", id);
+   fflush(fout);
+}
@@ -0,0 +1,40 @@
+#ifndef _MANIFEST_H_
+#define _MANIFEST_H_
+#include <cstdio>
+#include <string>
+#include <set>
+#include <mutex>
+
+/**
+ * Text manifest of one shard of a run, written next to its cases:
+ *
+ * seed <seed>
+ * level <level>
+ * shard <k> <N>
+ * format text|binary
+ * engine dfs|best-first
+ * params <test_num> <width> <height> <layers> <obs_num> <min_obs_size> <max_obs_size> <net_num> <pin_num>
+ * rng xoshiro|mt19937
+ * route <threads> <batch>   (only for --route-threads > 1)
+ * cost_limit <cells>   (only for --cost-limit)
+ * snapshot_in <dir>   (only for --snapshot-in)
+ * done <id>   (one line per finished case, appended as soon as its files are written)
+ *
+ * Opening an existing manifest checks that its header matches the current run
+ * and collects the finished ids, so rerunning the same command only generates the missing cases.
+ */
+class Manifest{
+public:
+   Manifest(const std::string & filename, const std::string & header);
+   ~Manifest();
+
+   bool isDone(int id) const{ return done.count(id) > 0; }
+   int doneNum() const{ return done.size(); }
+   void markDone(int id);//thread safe, flushed right away
+private:
+   std::mutex lock;
+   FILE * fout;
+   std::set<int> done;
+};
+
+#endif
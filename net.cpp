@@ -13,4 +13,10 @@ void Net::reset(){
    h_segments.clear();
    v_segments.clear();
    wl = 0;
-}
\ No newline at end of file
+}
+
+void Net::assign(int id, const std::vector<Point> & pins_){
+   reset();
+   net_id = id;
+   pins.assign(pins_.begin(), pins_.end());
+}
@@ -1,21 +1,25 @@
 #ifndef _NET_H_
 #define _NET_H_
 #include <vector>
+#include <array>
 #include "point.h"
 
+typedef std::array<int, 6> Segment;//x1 y1 z1 x2 y2 z2
+
 class Net{
 public:
    Net(int id, std::vector<Point> pins_);
    ~Net();
 
    void reset();
+   void assign(int id, const std::vector<Point> & pins_);//reuse a pooled net, keeps the capacity of its vectors
 
-   const size_t net_id;
+   size_t net_id;
    int wl;
    std::vector<Point> pins;
    std::vector<Point> vias;//z coordinate is the bottom layer of the via
-   std::vector<std::vector<int>> h_segments;
-   std::vector<std::vector<int>> v_segments;
+   std::vector<Segment> h_segments;
+   std::vector<Segment> v_segments;
 };
 
-#endif
\ No newline at end of file
+#endif
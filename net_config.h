@@ -1,12 +1,17 @@
 #ifndef _NET_CONFIG_H
 #define _NET_CONFIG_H
+enum Search_engine{
+   DFS_ENGINE = 0,//randomized depth-first search with momentum (searchEngine)
+   BEST_FIRST_ENGINE = 1,//priority queue ordered by length, distance and congestion (searchEngineBestFirst)
+};
+
 struct Net_config{
    Net_config(size_t _min_wl, size_t _max_wl, size_t _wl_limit, int _pin_num, int _reroute_num, float _momentum1, float _momentum2):
-      min_wl(_min_wl), max_wl(_max_wl), wl_limit(_wl_limit), pin_num(_pin_num), reroute_num(_reroute_num), momentum1(_momentum1), momentum2(_momentum2){
+      min_wl(_min_wl), max_wl(_max_wl), wl_limit(_wl_limit), pin_num(_pin_num), reroute_num(_reroute_num), momentum1(_momentum1), momentum2(_momentum2), engine(DFS_ENGINE), cost_limit(0){
 
       }
    Net_config(size_t _min_wl, size_t _max_wl, size_t _wl_limit, int _pin_num, int _reroute_num, float _momentum1):
-      min_wl(_min_wl), max_wl(_max_wl), wl_limit(_wl_limit), pin_num(_pin_num), reroute_num(_reroute_num), momentum1(_momentum1), momentum2(1.0){
+      min_wl(_min_wl), max_wl(_max_wl), wl_limit(_wl_limit), pin_num(_pin_num), reroute_num(_reroute_num), momentum1(_momentum1), momentum2(1.0), engine(DFS_ENGINE), cost_limit(0){
          
       }
    ~Net_config(){}
@@ -17,5 +22,7 @@ struct Net_config{
    int reroute_num;
    float momentum1;
    float momentum2;
+   Search_engine engine;
+   long long cost_limit;//cells a net may cost before it's abandoned, see Layout::overBudget (0: no limit)
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,22 @@
+#include "profiler.h"
+#include <iomanip>
+
+void Layout_stats::print(std::ostream & os) const{
+   const double total = obstacle_time + region_time + candidate_time + search_time + path2wire_time + save_time + verify_time;
+   auto phase = [&](const char * name, double t){
+      os << "  " << std::left << std::setw(20) << name << std::right << std::fixed << std::setprecision(3)
+         << std::setw(10) << t * 1e3 << " ms" << std::setw(8) << std::setprecision(1) << (total > 0 ? 100 * t / total : 0) << " %\n";
+   };
+   phase("generateObstacles", obstacle_time);
+   phase("region labeling", region_time);
+   phase("start candidates", candidate_time);
+   phase("searchEngine", search_time);
+   phase("path2Wire", path2wire_time);
+   phase("saveResult", save_time);
+   phase("verify", verify_time);
+   os << "  searchEngine calls " << search_calls << ", successes " << search_successes
+      << ", cells expanded " << cells_expanded << ", backtracks " << backtracks << "\n";
+   os << "  nets created " << nets_created << ", failed " << nets_failed << ", abandoned " << nets_abandoned << ", rejected pins " << rejected_pins
+      << ", skipped starts " << skipped_starts << ", route conflicts " << route_conflicts << "\n";
+   os.unsetf(std::ios::floatfield);
+}
@@ -0,0 +1,71 @@
+#ifndef _PROFILER_H_
+#define _PROFILER_H_
+#include <chrono>
+#include <ostream>
+
+/**
+ * Per-phase timers and search counters of a Layout, accumulated across cases until clear().
+ */
+struct Layout_stats{
+   Layout_stats(){ clear(); }
+   void clear(){
+      obstacle_time = region_time = candidate_time = search_time = path2wire_time = save_time = verify_time = 0;
+      search_calls = search_successes = cells_expanded = backtracks = rejected_pins = skipped_starts = 0;
+      nets_created = nets_failed = nets_abandoned = route_conflicts = 0;
+   }
+   Layout_stats & operator+=(const Layout_stats & s){
+      obstacle_time += s.obstacle_time;
+      region_time += s.region_time;
+      candidate_time += s.candidate_time;
+      search_time += s.search_time;
+      path2wire_time += s.path2wire_time;
+      save_time += s.save_time;
+      verify_time += s.verify_time;
+      search_calls += s.search_calls;
+      search_successes += s.search_successes;
+      cells_expanded += s.cells_expanded;
+      backtracks += s.backtracks;
+      rejected_pins += s.rejected_pins;
+      skipped_starts += s.skipped_starts;
+      nets_created += s.nets_created;
+      nets_failed += s.nets_failed;
+      nets_abandoned += s.nets_abandoned;
+      route_conflicts += s.route_conflicts;
+      return *this;
+   }
+   void print(std::ostream & os) const;
+
+   //seconds spent in each phase
+   double obstacle_time;//generateObstacles
+   double region_time;//labeling free-space regions
+   double candidate_time;//picking start cells in generateNet
+   double search_time;//searchEngine
+   double path2wire_time;//path2Wire
+   double save_time;//saveResult / serialize
+   double verify_time;//Verifier::verify, timed by the caller
+   //counters
+   long long search_calls;
+   long long search_successes;
+   long long cells_expanded;//cells popped by searchEngine
+   long long backtracks;//dead ends searchEngine backed out of
+   long long rejected_pins;//routed pins dropped for being next to another pin
+   long long skipped_starts;//starts whose region can't hold the drawn wirelength, not searched
+   long long nets_created;
+   long long nets_failed;
+   long long nets_abandoned;//given up by the reroute budget, see Net_config::cost_limit
+   long long route_conflicts;//nets routed by generateNetsParallel and dropped for overlapping an earlier slot
+};
+
+//adds the lifetime of the scope to a timer
+class Phase_timer{
+public:
+   Phase_timer(double & _timer) : timer(_timer), beg(std::chrono::steady_clock::now()){}
+   ~Phase_timer(){
+      timer += std::chrono::duration<double>(std::chrono::steady_clock::now() - beg).count();
+   }
+private:
+   double & timer;
+   std::chrono::steady_clock::time_point beg;
+};
+
+#endif
@@ -0,0 +1,344 @@
+/**
+ * layout_gen: python binding of Layout for in-memory dataset generation
+ *
+ * import numpy as np
+ * import layout_gen
+ * from serializer import BinaryCase
+ *
+ * L = layout_gen.Layout(500, 500, 3, seed=0)  # rng="mt19937" uses std::mt19937 through the std distributions, for callers who want that engine
+ * L.generate_obstacles([84, 83, 83], [(25, 250)] * 3)
+ * L.generate_nets(L.auto_config(15, 5))
+ * case = BinaryCase(np.frombuffer(L.export(), dtype=np.int32))
+ *
+ * export() serializes the case into a new record in the binary container layout (see writer.h), one copy per call
+ * that doesn't share memory with the Layout, owned by the returned Case. numpy views are taken on that record
+ * without a second copy and keep it alive.
+ *
+ * state = L.snapshot()  # bytes, see Layout::snapshot
+ * L.generate_nets(L.auto_config(60, 5))  # a denser case on the same die
+ * L.restore(state)  # back to the 15 nets, the next generate_nets draws the same 60 nets again
+ * A Layout object must not be used from several python threads at once.
+ */
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <sstream>
+#include "layout.h"
+
+struct CaseObject{
+   PyObject_HEAD
+   std::vector<int32_t> * record;
+};
+
+static void Case_dealloc(CaseObject * self){
+   delete self->record;
+   Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static int Case_getbuffer(CaseObject * self, Py_buffer * view, int flags){
+   return PyBuffer_FillInfo(view, (PyObject *)self, self->record->data(), self->record->size() * sizeof(int32_t), 1, flags);
+}
+
+static Py_ssize_t Case_len(CaseObject * self){
+   return self->record->size();
+}
+
+static PyBufferProcs Case_as_buffer = {
+   (getbufferproc)Case_getbuffer,
+   nullptr,
+};
+
+static PySequenceMethods Case_as_sequence = {
+   (lenfunc)Case_len,
+};
+
+static PyTypeObject CaseType = {
+   PyVarObject_HEAD_INIT(nullptr, 0)
+   "layout_gen.Case",
+};
+
+struct LayoutObject{
+   PyObject_HEAD
+   Layout * layout;
+};
+
+static void Layout_dealloc(LayoutObject * self){
+   delete self->layout;
+   Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static int Layout_init(LayoutObject * self, PyObject * args, PyObject * kwds){
+   static const char * kwlist[] = {"width", "height", "layers", "idx", "seed", "rng", nullptr};
+   int width, height, layers, idx = 0;
+   PyObject * seed = Py_None;
+   const char * rng = "xoshiro";
+   if(!PyArg_ParseTupleAndKeywords(args, kwds, "iii|iOs", (char **)kwlist, &width, &height, &layers, &idx, &seed, &rng)){
+      return -1;
+   }
+   const std::string rng_name(rng);
+   if(rng_name != "xoshiro" && rng_name != "mt19937"){
+      PyErr_SetString(PyExc_ValueError, "rng must be xoshiro or mt19937");
+      return -1;
+   }
+   const Random_engine engine = (rng_name == "mt19937") ? MT19937_ENGINE : XOSHIRO_ENGINE;
+   if(width < 2 || height < 2 || layers < 1){
+      PyErr_SetString(PyExc_ValueError, "layout must be at least 2x2x1");
+      return -1;
+   }
+   delete self->layout;
+   if(seed == Py_None){
+      self->layout = new Layout(width, height, layers, idx, idx + time(0), engine);
+   }else{
+      unsigned long long s = PyLong_AsUnsignedLongLongMask(seed);
+      if(PyErr_Occurred()) return -1;
+      self->layout = new Layout(width, height, layers, idx, s, engine);
+   }
+   return 0;
+}
+
+//Layout.__new__ without __init__ (or a failed __init__) leaves no layout behind the object
+static bool Layout_ready(LayoutObject * self){
+   if(self->layout == nullptr){
+      PyErr_SetString(PyExc_RuntimeError, "Layout is not initialized, Layout.__init__ was not called");
+      return false;
+   }
+   return true;
+}
+
+static PyObject * Layout_reset(LayoutObject * self, PyObject * args){
+   if(!Layout_ready(self)) return nullptr;
+   int idx;
+   unsigned long long seed;
+   if(!PyArg_ParseTuple(args, "iK", &idx, &seed)) return nullptr;
+   self->layout->reset(idx, seed);
+   Py_RETURN_NONE;
+}
+
+static PyObject * Layout_generate_obstacles(LayoutObject * self, PyObject * args){
+   if(!Layout_ready(self)) return nullptr;
+   PyObject * py_nums, * py_ranges;
+   if(!PyArg_ParseTuple(args, "OO", &py_nums, &py_ranges)) return nullptr;
+   PyObject * nums = PySequence_Fast(py_nums, "obs_num must be a sequence");
+   if(!nums) return nullptr;
+   PyObject * ranges = PySequence_Fast(py_ranges, "obs_size_range must be a sequence");
+   if(!ranges){
+      Py_DECREF(nums);
+      return nullptr;
+   }
+   std::vector<int> obs_num;
+   std::vector<std::pair<int, int>> obs_size_range;
+   for(Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(nums); ++i){
+      obs_num.push_back(PyLong_AsLong(PySequence_Fast_GET_ITEM(nums, i)));
+   }
+   for(Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(ranges); ++i){
+      int lo, hi;
+      if(!PyArg_ParseTuple(PySequence_Fast_GET_ITEM(ranges, i), "ii", &lo, &hi)) break;
+      obs_size_range.push_back({lo, hi});
+   }
+   Py_DECREF(nums);
+   Py_DECREF(ranges);
+   if(PyErr_Occurred()) return nullptr;
+   if((int)obs_num.size() > self->layout->getLayers() || obs_num.size() != obs_size_range.size()){
+      PyErr_SetString(PyExc_ValueError, "need one obs_num and one obs_size_range per layer");
+      return nullptr;
+   }
+   Py_BEGIN_ALLOW_THREADS
+   self->layout->generateObstacles(obs_num, obs_size_range);
+   Py_END_ALLOW_THREADS
+   Py_RETURN_NONE;
+}
+
+static PyObject * netConfigToDict(int net_num, const Net_config & c){
+   return Py_BuildValue("{s:i,s:n,s:n,s:n,s:i,s:i,s:f,s:f,s:i,s:L}",
+      "net_num", net_num, "min_wl", (Py_ssize_t)c.min_wl, "max_wl", (Py_ssize_t)c.max_wl, "wl_limit", (Py_ssize_t)c.wl_limit,
+      "pin_num", c.pin_num, "reroute_num", c.reroute_num, "momentum1", c.momentum1, "momentum2", c.momentum2, "engine", (int)c.engine,
+      "cost_limit", c.cost_limit);
+}
+
+static bool netConfigFromDict(PyObject * dict, std::vector<std::pair<int, Net_config>> & net_configs){
+   static const char * keys[] = {"net_num", "min_wl", "max_wl", "wl_limit", "pin_num", "reroute_num", "momentum1", "momentum2"};
+   double values[8];
+   if(!PyDict_Check(dict)){
+      PyErr_SetString(PyExc_TypeError, "net config must be a dict");
+      return false;
+   }
+   for(int i = 0; i < 8; ++i){
+      PyObject * v = PyDict_GetItemString(dict, keys[i]);
+      if(v == nullptr){
+         PyErr_Format(PyExc_KeyError, "net config misses '%s'", keys[i]);
+         return false;
+      }
+      values[i] = PyFloat_AsDouble(v);
+      if(PyErr_Occurred()) return false;
+   }
+   Net_config config(values[1], values[2], values[3], values[4], values[5], values[6], values[7]);
+   PyObject * engine = PyDict_GetItemString(dict, "engine");//optional, DFS_ENGINE by default
+   if(engine != nullptr){
+      long e = PyLong_AsLong(engine);
+      if(PyErr_Occurred()) return false;
+      if(e != DFS_ENGINE && e != BEST_FIRST_ENGINE){
+         PyErr_SetString(PyExc_ValueError, "engine must be 0 (dfs) or 1 (best-first)");
+         return false;
+      }
+      config.engine = (Search_engine)e;
+   }
+   PyObject * cost_limit = PyDict_GetItemString(dict, "cost_limit");//optional, no limit by default
+   if(cost_limit != nullptr){
+      config.cost_limit = PyLong_AsLongLong(cost_limit);
+      if(PyErr_Occurred()) return false;
+   }
+   net_configs.push_back({(int)values[0], config});
+   return true;
+}
+
+static PyObject * Layout_auto_config(LayoutObject * self, PyObject * args){
+   if(!Layout_ready(self)) return nullptr;
+   int net_num, pin_num;
+   if(!PyArg_ParseTuple(args, "ii", &net_num, &pin_num)) return nullptr;
+   std::vector<std::pair<int, Net_config>> net_configs;
+   self->layout->autoConfig(net_configs, net_num, pin_num);
+   PyObject * ret = PyList_New(0);
+   for(const std::pair<int, Net_config> & c : net_configs){
+      PyObject * d = netConfigToDict(c.first, c.second);
+      PyList_Append(ret, d);
+      Py_DECREF(d);
+   }
+   return ret;
+}
+
+static PyObject * Layout_generate_nets(LayoutObject * self, PyObject * args, PyObject * kwds){
+   if(!Layout_ready(self)) return nullptr;
+   static const char * kwlist[] = {"net_configs", "verbose", nullptr};
+   PyObject * py_configs;
+   int verbose = 0;
+   if(!PyArg_ParseTupleAndKeywords(args, kwds, "O|p", (char **)kwlist, &py_configs, &verbose)) return nullptr;
+   PyObject * configs = PySequence_Fast(py_configs, "net_configs must be a sequence");
+   if(!configs) return nullptr;
+   std::vector<std::pair<int, Net_config>> net_configs;
+   for(Py_ssize_t i = 0; i < PySequence_Fast_GET_SIZE(configs); ++i){
+      if(!netConfigFromDict(PySequence_Fast_GET_ITEM(configs, i), net_configs)){
+         Py_DECREF(configs);
+         return nullptr;
+      }
+   }
+   Py_DECREF(configs);
+   int total_nets;
+   std::ostringstream log;
+   Py_BEGIN_ALLOW_THREADS
+   total_nets = self->layout->generateNets(net_configs, log);
+   Py_END_ALLOW_THREADS
+   if(verbose) PySys_WriteStdout("%s", log.str().c_str());
+   return PyLong_FromLong(total_nets);
+}
+
+static PyObject * Layout_save_result(LayoutObject * self, PyObject * args, PyObject * kwds){
+   if(!Layout_ready(self)) return nullptr;
+   static const char * kwlist[] = {"filename", "write_routing", nullptr};
+   const char * filename;
+   int write_routing = 1;
+   if(!PyArg_ParseTupleAndKeywords(args, kwds, "s|p", (char **)kwlist, &filename, &write_routing)) return nullptr;
+   if(!self->layout->saveResult(filename, write_routing)) return PyErr_SetFromErrnoWithFilename(PyExc_OSError, filename);
+   Py_RETURN_NONE;
+}
+
+static PyObject * Layout_export(LayoutObject * self, PyObject * Py_UNUSED(ignored)){
+   if(!Layout_ready(self)) return nullptr;
+   CaseObject * c = PyObject_New(CaseObject, &CaseType);
+   if(!c) return nullptr;
+   c->record = new std::vector<int32_t>();
+   self->layout->serialize(*c->record);
+   return (PyObject *)c;
+}
+
+static PyObject * Layout_snapshot(LayoutObject * self, PyObject * Py_UNUSED(ignored)){
+   if(!Layout_ready(self)) return nullptr;
+   std::vector<int32_t> words;
+   self->layout->snapshot(words);
+   return PyBytes_FromStringAndSize(reinterpret_cast<const char *>(words.data()), words.size() * sizeof(int32_t));
+}
+
+static PyObject * Layout_restore(LayoutObject * self, PyObject * args){
+   if(!Layout_ready(self)) return nullptr;
+   Py_buffer state;
+   if(!PyArg_ParseTuple(args, "y*", &state)) return nullptr;
+   bool restored = false;
+   if(state.len % sizeof(int32_t) == 0){
+      std::vector<int32_t> words(state.len / sizeof(int32_t));//the buffer may not be aligned
+      memcpy(words.data(), state.buf, state.len);
+      restored = self->layout->restore(words.data(), words.size());
+   }
+   PyBuffer_Release(&state);
+   if(!restored){
+      PyErr_SetString(PyExc_ValueError, "malformed snapshot, or not of a layout of this die size");
+      return nullptr;
+   }
+   Py_RETURN_NONE;
+}
+
+static PyObject * Layout_net_num(LayoutObject * self, void * Py_UNUSED(closure)){
+   if(!Layout_ready(self)) return nullptr;
+   return PyLong_FromSize_t(self->layout->nets.size());
+}
+
+static PyObject * case_seed(PyObject * Py_UNUSED(cls), PyObject * args){
+   unsigned long long seed;
+   int level, idx, attempt = 0;
+   if(!PyArg_ParseTuple(args, "Kii|i", &seed, &level, &idx, &attempt)) return nullptr;
+   return PyLong_FromUnsignedLongLong(caseSeed(seed, level, idx, attempt));
+}
+
+static PyMethodDef Layout_methods[] = {
+   {"reset", (PyCFunction)Layout_reset, METH_VARARGS, "reset(idx, seed): start a new case reusing all storage"},
+   {"case_seed", (PyCFunction)case_seed, METH_VARARGS | METH_STATIC, "case_seed(seed, level, idx, attempt=0) -> seed of one case, same as main --seed"},
+   {"generate_obstacles", (PyCFunction)Layout_generate_obstacles, METH_VARARGS, "generate_obstacles(obs_num, obs_size_range)"},
+   {"auto_config", (PyCFunction)Layout_auto_config, METH_VARARGS, "auto_config(net_num, pin_num) -> list of net config dicts"},
+   {"generate_nets", (PyCFunction)Layout_generate_nets, METH_VARARGS | METH_KEYWORDS, "generate_nets(net_configs, verbose=False) -> number of nets created"},
+   {"save_result", (PyCFunction)Layout_save_result, METH_VARARGS | METH_KEYWORDS, "save_result(filename, write_routing=True), OSError if the file can't be written"},
+   {"export", (PyCFunction)Layout_export, METH_NOARGS, "export() -> Case, a copy of the case in the binary container record layout"},
+   {"snapshot", (PyCFunction)Layout_snapshot, METH_NOARGS, "snapshot() -> bytes, the obstacles, nets, random stream and reroute budget of the case"},
+   {"restore", (PyCFunction)Layout_restore, METH_VARARGS, "restore(snapshot): continue from a snapshot of a layout of the same die size"},
+   {nullptr}
+};
+
+static PyGetSetDef Layout_getset[] = {
+   {"net_num", (getter)Layout_net_num, nullptr, "number of nets created", nullptr},
+   {nullptr}
+};
+
+static PyTypeObject LayoutType = {
+   PyVarObject_HEAD_INIT(nullptr, 0)
+   "layout_gen.Layout",
+};
+
+static PyModuleDef layout_gen_module = {
+   PyModuleDef_HEAD_INIT,
+   "layout_gen",
+   "in-memory layout generator",
+   -1,
+};
+
+PyMODINIT_FUNC PyInit_layout_gen(void){
+   CaseType.tp_basicsize = sizeof(CaseObject);
+   CaseType.tp_dealloc = (destructor)Case_dealloc;
+   CaseType.tp_flags = Py_TPFLAGS_DEFAULT;
+   CaseType.tp_doc = "one generated case, exposes the binary record through the buffer protocol";
+   CaseType.tp_as_buffer = &Case_as_buffer;
+   CaseType.tp_as_sequence = &Case_as_sequence;
+
+   LayoutType.tp_basicsize = sizeof(LayoutObject);
+   LayoutType.tp_dealloc = (destructor)Layout_dealloc;
+   LayoutType.tp_flags = Py_TPFLAGS_DEFAULT;
+   LayoutType.tp_doc = "Layout(width, height, layers, idx=0, seed=None, rng='xoshiro')";
+   LayoutType.tp_methods = Layout_methods;
+   LayoutType.tp_getset = Layout_getset;
+   LayoutType.tp_init = (initproc)Layout_init;
+   LayoutType.tp_new = PyType_GenericNew;
+
+   if(PyType_Ready(&CaseType) < 0 || PyType_Ready(&LayoutType) < 0) return nullptr;
+   PyObject * m = PyModule_Create(&layout_gen_module);
+   if(!m) return nullptr;
+   Py_INCREF(&CaseType);
+   PyModule_AddObject(m, "Case", (PyObject *)&CaseType);
+   Py_INCREF(&LayoutType);
+   PyModule_AddObject(m, "Layout", (PyObject *)&LayoutType);
+   return m;
+}
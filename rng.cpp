@@ -0,0 +1,85 @@
+#include "rng.h"
+#include <algorithm>
+#include <sstream>
+
+Random_stream::Random_stream(uint64_t seed, Random_engine engine) : kind(engine){
+   this->seed(seed);
+}
+
+void Random_stream::seed(uint64_t seed){
+   if(kind == MT19937_ENGINE){
+      std::seed_seq seq{(uint32_t)seed, (uint32_t)(seed >> 32)};
+      mt.seed(seq);
+   }else{
+      xoshiro.seed(seed);
+   }
+   pos = RNG_BLOCK;
+}
+
+void Random_stream::refill(){
+   if(kind == MT19937_ENGINE){
+      for(uint32_t & word : block){
+         word = mt();
+      }
+   }else{
+      for(int i = 0; i < RNG_BLOCK; i += 2){
+         const uint64_t word = xoshiro.next();
+         block[i] = (uint32_t)word;
+         block[i + 1] = (uint32_t)(word >> 32);
+      }
+   }
+   pos = 0;
+}
+
+//engine pos [block[pos] .. block[RNG_BLOCK - 1]] state_words [state]
+//state: the 4 64-bit xoshiro words split in halves, or the textual state of std::mt19937 (624 words and its position)
+void Random_stream::save(std::vector<int32_t> & words) const{
+   words.push_back(kind);
+   words.push_back(pos);
+   words.insert(words.end(), block + pos, block + RNG_BLOCK);
+   std::vector<uint32_t> state;
+   if(kind == MT19937_ENGINE){
+      std::stringstream text;
+      text << mt;
+      for(uint32_t v; text >> v;){
+         state.push_back(v);
+      }
+   }else{
+      for(int i = 0; i < 4; ++i){
+         state.push_back((uint32_t)xoshiro.state()[i]);
+         state.push_back((uint32_t)(xoshiro.state()[i] >> 32));
+      }
+   }
+   words.push_back(state.size());
+   words.insert(words.end(), state.begin(), state.end());
+}
+
+const int32_t * Random_stream::load(const int32_t * beg, const int32_t * end){
+   if(end - beg < 2 || (beg[0] != XOSHIRO_ENGINE && beg[0] != MT19937_ENGINE) || beg[1] < 0 || beg[1] > RNG_BLOCK) return nullptr;
+   const Random_engine engine = (Random_engine)beg[0];
+   const int at = beg[1];
+   beg += 2;
+   if(end - beg < RNG_BLOCK - at + 1) return nullptr;
+   std::copy(beg, beg + (RNG_BLOCK - at), block + at);
+   beg += RNG_BLOCK - at;
+   const int32_t state_num = *beg++;
+   if(state_num < 0 || end - beg < state_num) return nullptr;
+   if(engine == MT19937_ENGINE){
+      std::stringstream text;
+      for(int i = 0; i < state_num; ++i){
+         text << (uint32_t)beg[i] << " ";
+      }
+      text >> mt;
+      if(text.fail()) return nullptr;
+   }else{
+      if(state_num != 8) return nullptr;
+      uint64_t state[4];
+      for(int i = 0; i < 4; ++i){
+         state[i] = (uint32_t)beg[2 * i] | ((uint64_t)(uint32_t)beg[2 * i + 1] << 32);
+      }
+      xoshiro.setState(state);
+   }
+   kind = engine;
+   pos = at;
+   return beg + state_num;
+}
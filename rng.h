@@ -0,0 +1,115 @@
+#ifndef _RNG_H_
+#define _RNG_H_
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#define RNG_BLOCK 256  // 32-bit words drawn from the engine at a time
+
+enum Random_engine{
+   XOSHIRO_ENGINE = 0,//xoshiro256++, 32 bytes of state, fast floats and ranges (default)
+   MT19937_ENGINE = 1,//mt19937 uses std::mt19937 through the std distributions, for callers who want that engine
+};
+
+inline uint64_t splitMix64(uint64_t x){
+   x += 0x9e3779b97f4a7c15ULL;
+   x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+   x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+   return x ^ (x >> 31);
+}
+
+//xoshiro256++ by Blackman & Vigna, state seeded with splitmix64
+class Xoshiro256pp{
+public:
+   void seed(uint64_t seed){
+      for(int i = 0; i < 4; ++i){//consecutive outputs of a splitmix64 generator started at seed
+         s[i] = splitMix64(seed + i * 0x9e3779b97f4a7c15ULL);
+      }
+   }
+   inline uint64_t next(){
+      const uint64_t result = rotl(s[0] + s[3], 23) + s[0];
+      const uint64_t t = s[1] << 17;
+      s[2] ^= s[0];
+      s[3] ^= s[1];
+      s[1] ^= s[2];
+      s[0] ^= s[3];
+      s[2] ^= t;
+      s[3] = rotl(s[3], 45);
+      return result;
+   }
+   const uint64_t * state() const{ return s; }
+   void setState(const uint64_t * state){
+      std::copy(state, state + 4, s);
+   }
+private:
+   static inline uint64_t rotl(uint64_t x, int k){
+      return (x << k) | (x >> (64 - k));
+   }
+   uint64_t s[4];
+};
+
+/**
+ * Random source of a Layout: 32-bit words served from a block refilled RNG_BLOCK words at a time,
+ * usable as a UniformRandomBitGenerator (std::shuffle, std distributions).
+ * uniform() and range() are the hot-path draws: with XOSHIRO_ENGINE a float is one word scaled, a range one multiply-shift (Lemire),
+ * with MT19937_ENGINE they go through std::uniform_*_distribution, so the words and results are the ones of a bare std::mt19937.
+ * The engine is picked with setEngine and applies from the next seed().
+ */
+class Random_stream{
+public:
+   typedef uint32_t result_type;
+   static constexpr result_type min(){ return 0; }
+   static constexpr result_type max(){ return UINT32_MAX; }
+
+   explicit Random_stream(uint64_t seed = 0, Random_engine engine = XOSHIRO_ENGINE);
+
+   void setEngine(Random_engine engine){ kind = engine; }
+   Random_engine getEngine() const{ return kind; }
+   void seed(uint64_t seed);
+   //engine, the unread words of the block and the engine state, appended to words, the stream continues identically after load
+   void save(std::vector<int32_t> & words) const;
+   const int32_t * load(const int32_t * beg, const int32_t * end);//one past the state, nullptr if malformed
+
+   inline result_type operator()(){
+      if(pos == RNG_BLOCK) refill();
+      return block[pos++];
+   }
+   //uniform in [min, max)
+   inline float uniform(float min = 0.0, float max = 1.0){
+      if(kind == MT19937_ENGINE){//what std::uniform_real_distribution<float> computes from one 32-bit word (libstdc++)
+         float r = (float)(*this)() * (1.0f / 4294967296.0f);
+         if(r >= 1.0f) r = std::nextafter(1.0f, 0.0f);
+         return r * (max - min) + min;
+      }
+      return min + (max - min) * ((*this)() >> 8) * (1.0f / 16777216);
+   }
+   //uniform in [min, max]
+   inline int range(int min, int max){
+      if(kind == MT19937_ENGINE){
+         std::uniform_int_distribution<int> distribution(min, max);
+         return distribution(*this);
+      }
+      const uint32_t n = (uint32_t)max - (uint32_t)min + 1;
+      if(n == 0) return (int)(*this)();//the whole 32-bit range
+      uint64_t m = (uint64_t)(*this)() * n;
+      if((uint32_t)m < n){//reject the few low words that would bias the result
+         const uint32_t threshold = -n % n;
+         while((uint32_t)m < threshold){
+            m = (uint64_t)(*this)() * n;
+         }
+      }
+      return min + (int)(m >> 32);
+   }
+private:
+   void refill();
+
+   Random_engine kind;
+   std::mt19937 mt;
+   Xoshiro256pp xoshiro;
+   int pos;
+   uint32_t block[RNG_BLOCK];
+};
+
+#endif
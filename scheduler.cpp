@@ -0,0 +1,52 @@
+#include "scheduler.h"
+
+Scheduler::Scheduler(int task_num, int worker_num) : queues(std::max(worker_num, 1)){
+   std::vector<int> tasks(std::max(task_num, 0));
+   for(int i = 0; i < (int)tasks.size(); ++i){
+      tasks[i] = i;
+   }
+   distribute(tasks);
+}
+
+Scheduler::Scheduler(const std::vector<int> & tasks, int worker_num) : queues(std::max(worker_num, 1)){
+   distribute(tasks);
+}
+
+void Scheduler::distribute(const std::vector<int> & tasks){
+   const int n = queues.size();
+   const long long task_num = tasks.size();
+   for(int w = 0; w < n; ++w){
+      int beg = task_num * w / n;
+      int end = task_num * (w + 1) / n;
+      for(int i = beg; i < end; ++i){
+         queues[w].tasks.push_back(tasks[i]);
+      }
+   }
+}
+
+bool Scheduler::next(int worker, int & task){
+   Task_queue & own = queues[worker];
+   {
+      std::lock_guard<std::mutex> guard(own.lock);
+      if(!own.tasks.empty()){
+         task = own.tasks.front();
+         own.tasks.pop_front();
+         return true;
+      }
+   }
+   return steal(worker, task);
+}
+
+bool Scheduler::steal(int thief, int & task){
+   const int n = queues.size();
+   for(int k = 1; k < n; ++k){
+      Task_queue & victim = queues[(thief + k) % n];
+      std::lock_guard<std::mutex> guard(victim.lock);
+      if(!victim.tasks.empty()){
+         task = victim.tasks.back();
+         victim.tasks.pop_back();
+         return true;
+      }
+   }
+   return false;
+}
@@ -0,0 +1,33 @@
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+/**
+ * Work-stealing scheduler over test indices [0, task_num) or a given list of indices.
+ * Every worker owns a deque seeded with a contiguous block of indices,
+ * pops from its own front and, once empty, steals from the back of the
+ * other workers' deques so long-running cases don't leave cores idle.
+ */
+class Scheduler{
+public:
+   Scheduler(int task_num, int worker_num);
+   Scheduler(const std::vector<int> & tasks, int worker_num);
+
+   bool next(int worker, int & task);//false when every deque is drained
+   int workerNum() const{ return (int)queues.size(); }
+private:
+   struct Task_queue{
+      std::mutex lock;
+      std::deque<int> tasks;
+   };
+   void distribute(const std::vector<int> & tasks);
+   bool steal(int thief, int & task);
+
+   std::vector<Task_queue> queues;
+};
+
+#endif
@@ -28,12 +28,29 @@ V_segment_num [vertical segment numbers]
 """
 
 import argparse
+import mmap
+import numpy as np
 import matplotlib.pyplot as plt
 from matplotlib.patches import Rectangle
 
 HORIZONTAL = 0
 VIA_COST = 1
 
+""" Binary container (cases.bin, see writer.h), little-endian int32 words
+"LGEN" [version]
+[payload bytes] [payload]  # one record per case
+...
+payload:
+[case_id] [width] [height] [layers] [total_WL] [total_via]
+[obs_num] [net_num] [pin_total] [via_total] [h_seg_total] [v_seg_total]
+obstacles[obs_num][6]
+nets[net_num][6]  # net_id, wl, pin_num, via_num, h_seg_num, v_seg_num
+pins[pin_total][3] vias[via_total][3] h_segs[h_seg_total][6] v_segs[v_seg_total][6]
+"""
+BINARY_MAGIC = b"LGEN"
+BINARY_VERSION = 1
+BINARY_HEADER_WORDS = 12
+
 
 class Net:
     def __init__(self, id, pins, vias, h_segs, v_segs) -> None:
@@ -342,14 +359,127 @@ class Testcase:
         plt.close(fig)
 
 
+class BinaryCase:
+    """
+    one record of a binary container, every array is a view into the mapped file
+    """
+
+    def __init__(self, words: np.ndarray) -> None:
+        (
+            self.case_id,
+            self.width,
+            self.height,
+            self.layers,
+            self.total_WL,
+            self.total_via,
+            obs_num,
+            net_num,
+            pin_total,
+            via_total,
+            h_seg_total,
+            v_seg_total,
+        ) = (int(w) for w in words[:BINARY_HEADER_WORDS])
+        offset = BINARY_HEADER_WORDS
+
+        def take(rows, cols):
+            nonlocal offset
+            arr = words[offset : offset + rows * cols].reshape(rows, cols)
+            offset += rows * cols
+            return arr
+
+        self.obstacles = take(obs_num, 6)
+        self.nets = take(net_num, 6)  # net_id, wl, pin_num, via_num, h_seg_num, v_seg_num
+        self.pins = take(pin_total, 3)
+        self.vias = take(via_total, 3)
+        self.h_segs = take(h_seg_total, 6)
+        self.v_segs = take(v_seg_total, 6)
+        assert offset == len(words)
+
+    def net_offsets(self, column: int) -> np.ndarray:
+        """
+        start offset of every net in pins (2), vias (3), h_segs (4) or v_segs (5)
+        """
+        offsets = np.zeros(len(self.nets) + 1, dtype=np.int64)
+        np.cumsum(self.nets[:, column], out=offsets[1:])
+        return offsets
+
+    def to_testcase(self) -> Testcase:
+        pin_off = self.net_offsets(2)
+        via_off = self.net_offsets(3)
+        h_off = self.net_offsets(4)
+        v_off = self.net_offsets(5)
+        nets = []
+        for i, net in enumerate(self.nets):
+            nets.append(
+                Net(
+                    id=int(net[0]),
+                    pins=[[tuple(p)] for p in self.pins[pin_off[i] : pin_off[i + 1]].tolist()],
+                    vias=[tuple(v) for v in self.vias[via_off[i] : via_off[i + 1]].tolist()],
+                    h_segs=[tuple(h) for h in self.h_segs[h_off[i] : h_off[i + 1]].tolist()],
+                    v_segs=[tuple(v) for v in self.v_segs[v_off[i] : v_off[i + 1]].tolist()],
+                )
+            )
+        ret = Testcase(
+            h_start_point=0,
+            h_end_point=self.width,
+            v_start_point=0,
+            v_end_point=self.height,
+            Layer=self.layers,
+            tracks=[(0, 1, i % 2) for i in range(self.layers)],
+            obstacles=self.obstacles.tolist(),
+            nets=nets,
+        )
+        ret.total_WL = self.total_WL
+        ret.total_via = self.total_via
+        return ret
+
+
+class BinaryCases:
+    """
+    memory-mapped reader of a binary container, only record sizes are read up front
+    """
+
+    def __init__(self, in_file: str) -> None:
+        self.file = open(in_file, "rb")
+        self.mm = mmap.mmap(self.file.fileno(), 0, access=mmap.ACCESS_READ)
+        assert self.mm[:4] == BINARY_MAGIC, f"{in_file} is not a binary container"
+        self.words = np.frombuffer(self.mm, dtype="<i4")
+        assert self.words[1] == BINARY_VERSION, f"unsupported version {self.words[1]}"
+        self.offsets: list[tuple[int, int]] = []  # (begin word, end word) of each payload
+        pos = 2
+        while pos < len(self.words):
+            size = int(self.words[pos]) // 4
+            self.offsets.append((pos + 1, pos + 1 + size))
+            pos += 1 + size
+        assert pos == len(self.words), f"{in_file} is truncated"
+
+    def __len__(self) -> int:
+        return len(self.offsets)
+
+    def __getitem__(self, i: int) -> BinaryCase:
+        beg, end = self.offsets[i]
+        return BinaryCase(self.words[beg:end])
+
+    def __iter__(self):
+        for i in range(len(self)):
+            yield self[i]
+
+    def by_case_id(self) -> dict[int, BinaryCase]:
+        return {case.case_id: case for case in self}
+
+
 if __name__ == "__main__":
     parser = argparse.ArgumentParser()
     parser.add_argument("-i", type=str)
     parser.add_argument("-o", type=str)
     parser.add_argument("--write_segments", type=bool, default=True)
     parser.add_argument("--image", type=str)
+    parser.add_argument("--case", type=int, default=0)  # case_id to read from a binary container
     args = parser.parse_args()
-    testcase = Testcase.deserialize(args.i)
+    if args.i.endswith(".bin"):
+        testcase = BinaryCases(args.i).by_case_id()[args.case].to_testcase()
+    else:
+        testcase = Testcase.deserialize(args.i)
     if args.o is not None:
         testcase.serialize(args.o, args.write_segments)
     if args.image is not None:
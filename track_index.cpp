@@ -0,0 +1,127 @@
+#include "track_index.h"
+#include <algorithm>
+#include "debugger.h"
+
+void TrackIndex::resize(int track_num, int _track_len, int _sample_tracks, int _sample_len){
+   track_len = _track_len;
+   sample_tracks = _sample_tracks;
+   sample_len = std::max(_sample_len, 0);
+   tracks.resize(track_num);
+   buckets.resize(sample_len + 1);
+   clear();
+}
+
+void TrackIndex::clear(){
+   for(std::map<int, int> & t : tracks){
+      t.clear();
+   }
+   for(std::vector<int> & b : buckets){
+      b.clear();
+   }
+   gaps.clear();
+   unused_gaps.clear();
+   gap_count.assign(sample_len + 1, 0);
+   gap_length.assign(sample_len + 1, 0);
+   for(int track = 0; track < (int)tracks.size(); ++track){
+      addGap(track, 0, track_len);
+   }
+}
+
+bool TrackIndex::isFree(int track, int beg, int end) const{
+   const std::map<int, int> & t = tracks[track];
+   auto gap = t.upper_bound(beg);
+   if(gap == t.begin()) return false;
+   return gaps[std::prev(gap)->second].end >= end;
+}
+
+void TrackIndex::insert(int track, int beg, int end){
+   M_Assert(isFree(track, beg, end), "interval overlaps");
+   std::map<int, int> & t = tracks[track];
+   auto it = std::prev(t.upper_bound(beg));
+   const Gap gap = gaps[it->second];
+   removeGap(it->second);
+   t.erase(it);
+   if(gap.beg < beg) addGap(track, gap.beg, beg);
+   if(end < gap.end) addGap(track, end, gap.end);
+}
+
+long long TrackIndex::countFree(int len) const{
+   if(len < 1 || len > sample_len) return 0;
+   //a gap of length l holds l - len + 1 starts
+   const long long count = prefix(gap_count, sample_len) - prefix(gap_count, len - 1);
+   const long long length = prefix(gap_length, sample_len) - prefix(gap_length, len - 1);
+   return length - (long long)(len - 1) * count;
+}
+
+void TrackIndex::nthFree(long long k, int len, int & track, int & beg) const{
+   M_Assert(k >= 0 && k < countFree(len), "k out of range");
+   const long long count_base = prefix(gap_count, len - 1), length_base = prefix(gap_length, len - 1);
+   auto starts = [&](int l){//starts in the gaps of lengths [len, l]
+      return (prefix(gap_length, l) - length_base) - (long long)(len - 1) * (prefix(gap_count, l) - count_base);
+   };
+   int lo = len, hi = sample_len;//smallest length whose cumulated starts exceed k
+   while(lo < hi){
+      const int mid = (lo + hi) / 2;
+      if(starts(mid) > k){
+         hi = mid;
+      }else{
+         lo = mid + 1;
+      }
+   }
+   k -= starts(lo - 1);
+   const int per_gap = lo - len + 1;
+   const Gap & gap = gaps[buckets[lo][k / per_gap]];
+   track = gap.track;
+   beg = gap.beg + k % per_gap;
+}
+
+void TrackIndex::addGap(int track, int beg, int end){
+   int id;
+   if(unused_gaps.size()){
+      id = unused_gaps.back();
+      unused_gaps.pop_back();
+   }else{
+      id = gaps.size();
+      gaps.push_back(Gap());
+   }
+   Gap & gap = gaps[id];
+   gap.track = track;
+   gap.beg = beg;
+   gap.end = end;
+   gap.length = track < sample_tracks ? std::max(std::min(end, sample_len) - beg, 0) : 0;
+   tracks[track][beg] = id;
+   if(gap.length){
+      gap.pos = buckets[gap.length].size();
+      buckets[gap.length].push_back(id);
+      add(gap.length, 1);
+   }
+}
+
+void TrackIndex::removeGap(int id){
+   const Gap & gap = gaps[id];
+   if(gap.length){//swap-remove from its bucket
+      std::vector<int> & bucket = buckets[gap.length];
+      const int last = bucket.back();
+      bucket[gap.pos] = last;
+      gaps[last].pos = gap.pos;
+      bucket.pop_back();
+      add(gap.length, -1);
+   }
+   unused_gaps.push_back(id);
+}
+
+void TrackIndex::add(int length, int count){
+   for(int i = length; i <= sample_len; i += i & -i){
+      gap_count[i] += count;
+      gap_length[i] += count * length;
+   }
+}
+
+//sum over lengths [1, length]
+long long TrackIndex::prefix(const std::vector<long long> & tree, int length) const{
+   long long sum = 0;
+   for(int i = length; i > 0; i -= i & -i){
+      sum += tree[i];
+   }
+   return sum;
+}
@@ -0,0 +1,45 @@
+#ifndef _TRACK_INDEX_H_
+#define _TRACK_INDEX_H_
+#include <map>
+#include <vector>
+
+/**
+ * Free gaps of every track of one layer, a track being a row of a horizontal layer or a column of a vertical layer.
+ * Lets obstacles be placed without reading any cell: a free test or an insertion is O(log n),
+ * and the free starts of an interval length are counted in O(log n) and drawn uniformly in O(log^2 n)
+ * from gaps bucketed by length, with Fenwick trees over the bucket sizes.
+ */
+class TrackIndex{
+public:
+   //only starts s on tracks [0, sample_tracks) with s + len <= sample_len are counted and drawn
+   void resize(int track_num, int track_len, int sample_tracks, int sample_len);
+   void clear();//every track empty
+
+   bool isFree(int track, int beg, int end) const;
+   void insert(int track, int beg, int end);
+   long long countFree(int len) const;
+   //k-th start counted by countFree(len), k < countFree(len)
+   void nthFree(long long k, int len, int & track, int & beg) const;
+private:
+   struct Gap{
+      int track, beg, end;
+      int length;//drawable length, 0 if not drawable
+      int pos;//index in buckets[length]
+   };
+   void addGap(int track, int beg, int end);
+   void removeGap(int id);
+   void add(int length, int count);
+   long long prefix(const std::vector<long long> & tree, int length) const;
+
+   int track_len;
+   int sample_tracks;
+   int sample_len;
+   std::vector<std::map<int, int>> tracks;//beg -> gap id, for each track
+   std::vector<Gap> gaps;
+   std::vector<int> unused_gaps;
+   std::vector<std::vector<int>> buckets;//drawable gap ids by length
+   std::vector<long long> gap_count;//Fenwick trees over lengths: gaps, and their total length
+   std::vector<long long> gap_length;
+};
+
+#endif
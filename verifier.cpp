@@ -0,0 +1,195 @@
+#include "verifier.h"
+#include <algorithm>
+#include <numeric>
+#include <thread>
+
+//sets bits [beg, beg + len) word by word
+static void setBits(std::vector<uint64_t> & bits, size_t beg, size_t len){
+   for(size_t end = beg + len; beg < end;){
+      const size_t w = beg >> 6, off = beg & 63;
+      const size_t n = std::min<size_t>(64 - off, end - beg);
+      bits[w] |= (n == 64 ? ~uint64_t(0) : ((uint64_t(1) << n) - 1)) << off;
+      beg += n;
+   }
+}
+
+static int findRoot(std::vector<int> & parent, int e){
+   while(parent[e] != e){
+      parent[e] = parent[parent[e]];
+      e = parent[e];
+   }
+   return e;
+}
+
+void Verify_result::print(std::ostream & os) const{
+   static const char * names[] = {"out of range", "malformed", "obstacle hit", "overlap", "disconnected", "wl mismatch"};
+   os << (legal() ? "legal" : "illegal") << ": " << nets << " nets, " << cells << " cells, wl " << wl
+      << ", " << violation_num << " violations\n";
+   for(const Violation & v : violations){
+      os << "  " << names[v.type] << " net " << v.net_id << " " << v.p << "\n";
+   }
+}
+
+Verifier::Verifier(int _width, int _height, int _layers, int _thread_num) :
+   width(_width), height(_height), layers(_layers), thread_num(std::max(1, _thread_num)),
+   words(((size_t)_width * _height * _layers + 63) / 64), blocked(words), used(new std::atomic<uint64_t>[words]), scratch(thread_num)
+{
+}
+
+void Verifier::report(Scratch & s, Violation_type type, int net_id, const Point & p){
+   ++s.violation_num;
+   if(s.listed++ < VERIFY_MAX_VIOLATIONS){
+      s.violations.push_back({type, net_id, p});
+   }
+}
+
+Verify_result Verifier::verify(const Layout & L){
+   M_Assert(L.getWidth() == width && L.getHeight() == height && L.getLayers() == layers, "die size differs from the verifier");
+   std::fill(blocked.begin(), blocked.end(), 0);
+   for(size_t w = 0; w < words; ++w){
+      used[w].store(0, std::memory_order_relaxed);
+   }
+   for(Scratch & s : scratch){
+      s.violations.clear();
+      s.violation_num = s.cells_num = s.wl = 0;
+   }
+   scratch[0].listed = 0;
+   markObstacles(L, scratch[0]);
+
+   const int net_num = L.nets.size();
+   const int threads = std::max(1, std::min(thread_num, net_num / VERIFY_NETS_PER_THREAD));
+   std::atomic<int> next(0);
+   auto worker = [&](int t){
+      Scratch & s = scratch[t];
+      for(int i; (i = next.fetch_add(1, std::memory_order_relaxed)) < net_num;){
+         verifyNet(*L.nets[i], s);
+      }
+   };
+   std::vector<std::thread> workers;
+   for(int t = 1; t < threads; ++t){
+      workers.emplace_back(worker, t);
+   }
+   worker(0);
+   for(std::thread & w : workers){
+      w.join();
+   }
+
+   Verify_result result;
+   result.nets = net_num;
+   result.cells = result.wl = result.violation_num = 0;
+   for(Scratch & s : scratch){
+      result.cells += s.cells_num;
+      result.wl += s.wl;
+      result.violation_num += s.violation_num;
+      result.violations.insert(result.violations.end(), s.violations.begin(), s.violations.end());
+   }
+   std::stable_sort(result.violations.begin(), result.violations.end(),
+      [](const Violation & a, const Violation & b){ return a.net_id < b.net_id; });
+   return result;
+}
+
+void Verifier::markObstacles(const Layout & L, Scratch & s){
+   for(const std::pair<Point, Point> & o : L.obstacles){
+      const Point & p1 = o.first, & p2 = o.second;//cells [p1.x, p2.x) x [p1.y, p2.y) x [p1.z, p2.z]
+      if(p1.x < 0 || p1.y < 0 || p1.z < 0 || p2.x > width || p2.y > height || p2.z >= layers){
+         report(s, OUT_OF_RANGE, -1, p1);
+         continue;
+      }
+      for(int z = p1.z; z <= p2.z; ++z){
+         for(int y = p1.y; y < p2.y; ++y){
+            setBits(blocked, cellIndex(p1.x, y, z), std::max(0, p2.x - p1.x));
+         }
+      }
+   }
+}
+
+void Verifier::verifyNet(const Net & n, Scratch & s){
+   const int id = n.net_id;
+   s.listed = 0;
+   s.cells.clear();
+   s.first_cell.clear();
+   auto inDie = [&](int x, int y, int z){
+      return x >= 0 && x < width && y >= 0 && y < height && z >= 0 && z < layers;
+   };
+   //every element is rasterized into (cell, element) pairs, first_cell keeps one of its cells or -1 when it's skipped
+   bool skipped = false;
+   auto skip = [&](Violation_type type, const Point & p){
+      report(s, type, id, p);
+      skipped = true;
+      s.first_cell.push_back(-1);
+   };
+   for(const Point & p : n.pins){
+      if(!inDie(p.x, p.y, p.z)){
+         skip(OUT_OF_RANGE, p);
+         continue;
+      }
+      s.first_cell.push_back(cellIndex(p.x, p.y, p.z));
+      s.cells.push_back({s.first_cell.back(), (int)s.first_cell.size() - 1});
+   }
+   long long wl = n.vias.size();
+   for(const Point & p : n.vias){//z is the bottom layer
+      if(!inDie(p.x, p.y, p.z) || !inDie(p.x, p.y, p.z + 1)){
+         skip(inDie(p.x, p.y, p.z) ? MALFORMED : OUT_OF_RANGE, p);
+         continue;
+      }
+      const int e = s.first_cell.size();
+      s.first_cell.push_back(cellIndex(p.x, p.y, p.z));
+      s.cells.push_back({s.first_cell.back(), e});
+      s.cells.push_back({cellIndex(p.x, p.y, p.z + 1), e});
+   }
+   for(int vertical = 0; vertical < 2; ++vertical){
+      for(const Segment & seg : vertical ? n.v_segments : n.h_segments){//x1 y1 z1 x2 y2 z2, [x1, x2) x [y1, y2)
+         const Point p1(seg[0], seg[1], seg[2]);
+         const int len = vertical ? seg[4] - seg[1] : seg[3] - seg[0];
+         const int across = vertical ? seg[3] - seg[0] : seg[4] - seg[1];
+         if(seg[2] != seg[5] || (seg[2] & 1) != vertical || across != 1 || len < 2){
+            skip(MALFORMED, p1);
+            continue;
+         }
+         if(!inDie(p1.x, p1.y, p1.z) || !inDie(seg[3] - 1, seg[4] - 1, seg[5])){
+            skip(OUT_OF_RANGE, p1);
+            continue;
+         }
+         const int e = s.first_cell.size();
+         s.first_cell.push_back(cellIndex(p1.x, p1.y, p1.z));
+         for(int k = 0; k < len; ++k){
+            s.cells.push_back({vertical ? cellIndex(p1.x, p1.y + k, p1.z) : cellIndex(p1.x + k, p1.y, p1.z), e});
+         }
+         wl += len - 1;
+      }
+   }
+
+   //elements sharing a cell are connected, every distinct cell is claimed once
+   s.parent.resize(s.first_cell.size());
+   std::iota(s.parent.begin(), s.parent.end(), 0);
+   std::sort(s.cells.begin(), s.cells.end());
+   auto cellPoint = [&](int cell){
+      return Point(cell % width, cell / width % height, cell / width / height);
+   };
+   for(size_t i = 0, j; i < s.cells.size(); i = j){
+      const int cell = s.cells[i].first;
+      const int root = findRoot(s.parent, s.cells[i].second);
+      for(j = i + 1; j < s.cells.size() && s.cells[j].first == cell; ++j){
+         s.parent[findRoot(s.parent, s.cells[j].second)] = root;
+      }
+      ++s.cells_num;
+      const uint64_t bit = uint64_t(1) << (cell & 63);
+      if(blocked[cell >> 6] & bit){
+         report(s, OBSTACLE_HIT, id, cellPoint(cell));
+      }else if(used[cell >> 6].fetch_or(bit, std::memory_order_relaxed) & bit){
+         report(s, OVERLAP, id, cellPoint(cell));
+      }
+   }
+   if(s.first_cell.size() && s.first_cell[0] >= 0){
+      const int root = findRoot(s.parent, 0);
+      for(size_t e = 1; e < s.first_cell.size(); ++e){
+         if(s.first_cell[e] >= 0 && findRoot(s.parent, e) != root){
+            report(s, DISCONNECTED, id, cellPoint(s.first_cell[e]));
+         }
+      }
+   }
+   if(n.wl != wl && !skipped){//a skipped element already explains a mismatch
+      report(s, WL_MISMATCH, id, Point(n.wl, wl, 0));
+   }
+   s.wl += wl;
+}
@@ -0,0 +1,76 @@
+#ifndef _VERIFIER_H_
+#define _VERIFIER_H_
+#include <atomic>
+#include <memory>
+#include <ostream>
+#include <utility>
+#include <vector>
+#include "layout.h"
+
+#define VERIFY_NETS_PER_THREAD 16  // fewer nets per thread aren't worth starting one
+#define VERIFY_MAX_VIOLATIONS 8  // reported per net, the rest are only counted
+
+enum Violation_type{
+   OUT_OF_RANGE = 0,//a pin, via, segment or obstacle outside the die
+   MALFORMED,//a segment off its layer direction or without edges, a via from the top layer
+   OBSTACLE_HIT,//a net cell inside an obstacle
+   OVERLAP,//a cell used by two nets, reported by whichever of them claims it second
+   DISCONNECTED,//a pin, via or segment not connected to the first pin of its net
+   WL_MISMATCH,//Net::wl differs from its vias plus segment edges
+};
+
+struct Violation{
+   Violation_type type;
+   int net_id;//-1 for obstacles
+   Point p;//offending cell, (Net::wl, recomputed wl, 0) for WL_MISMATCH
+};
+
+struct Verify_result{
+   int nets;
+   long long cells;//distinct net cells
+   long long wl;//recomputed total wirelength
+   long long violation_num;//including the ones not listed
+   std::vector<Violation> violations;//sorted by net id
+   bool legal() const{ return violation_num == 0; }
+   void print(std::ostream & os) const;
+};
+
+/**
+ * Standalone legality check of a generated case, independent of the grid the generator routed on:
+ * every pin, via and segment is rasterized into bitsets of the die (one bit per cell, the size of the die / 8 bytes),
+ * net cells are claimed with an atomic fetch_or so nets are checked in parallel without locks,
+ * and each net is checked for connectivity (union-find over its pins, vias and segments sharing cells) and wl.
+ * Storage is allocated once per die size and reused by every verify().
+ */
+class Verifier{
+public:
+   Verifier(int _width, int _height, int _layers, int _thread_num = 1);
+
+   Verify_result verify(const Layout & L);
+private:
+   struct Scratch{
+      std::vector<std::pair<int, int>> cells;//(cell, element) of one net
+      std::vector<int> parent;//union-find over the elements of one net
+      std::vector<int> first_cell;//a cell of every element, -1 when skipped
+      std::vector<Violation> violations;
+      long long violation_num, cells_num, wl;
+      int listed;//violations listed for the current net
+   };
+   inline int cellIndex(int x, int y, int z) const{
+      return (z * height + y) * width + x;
+   }
+   void markObstacles(const Layout & L, Scratch & s);
+   void verifyNet(const Net & n, Scratch & s);
+   void report(Scratch & s, Violation_type type, int net_id, const Point & p);
+
+   const int width;
+   const int height;
+   const int layers;
+   const int thread_num;
+   const size_t words;
+   std::vector<uint64_t> blocked;//obstacle cells
+   std::unique_ptr<std::atomic<uint64_t>[]> used;//net cells, claimed by fetch_or
+   std::vector<Scratch> scratch;//one per thread
+};
+
+#endif
@@ -0,0 +1,82 @@
+#include "writer.h"
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+BinaryWriter::BinaryWriter(const std::string & filename, size_t buffer_size, bool resume) : buffer(buffer_size), used(0){
+   fout = fopen(filename.c_str(), resume ? "ab" : "wb");
+   if(fout == nullptr){
+      std::cerr << "Cannot save the result." << std::endl;
+      std::cerr << "Please check." << std::endl;
+      exit(1);
+   }
+   fseek(fout, 0, SEEK_END);
+   if(ftell(fout) == 0){
+      const int32_t version = BINARY_VERSION;
+      append(BINARY_MAGIC, 4);
+      append(&version, sizeof(version));
+   }
+}
+
+std::vector<int> BinaryWriter::recover(const std::string & filename){
+   std::vector<int> ids;
+   FILE * fin = fopen(filename.c_str(), "rb");
+   if(fin == nullptr) return ids;
+   fseek(fin, 0, SEEK_END);
+   const long file_size = ftell(fin);
+   fseek(fin, 0, SEEK_SET);
+   char magic[4];
+   int32_t version;
+   long valid = 0;
+   if(fread(magic, 1, 4, fin) == 4 && memcmp(magic, BINARY_MAGIC, 4) == 0 &&
+      fread(&version, sizeof(version), 1, fin) == 1 && version == BINARY_VERSION){
+      valid = ftell(fin);
+      int32_t size, case_id;
+      while(fread(&size, sizeof(size), 1, fin) == 1 && size >= (int32_t)sizeof(case_id) &&
+            valid + (long)sizeof(size) + size <= file_size && fread(&case_id, sizeof(case_id), 1, fin) == 1){
+         valid += sizeof(size) + size;
+         ids.push_back(case_id);
+         fseek(fin, valid, SEEK_SET);
+      }
+   }
+   fclose(fin);
+   if(valid < file_size && truncate(filename.c_str(), valid) != 0){
+      std::cerr << "Cannot repair " << filename << "." << std::endl;
+      exit(1);
+   }
+   return ids;
+}
+
+BinaryWriter::~BinaryWriter(){
+   flush();
+   fclose(fout);
+}
+
+void BinaryWriter::write(const std::vector<int32_t> & record){
+   std::lock_guard<std::mutex> guard(lock);
+   const int32_t size = record.size() * sizeof(int32_t);
+   append(&size, sizeof(size));
+   append(record.data(), size);
+}
+
+void BinaryWriter::flush(){
+   if(used){
+      fwrite(buffer.data(), 1, used, fout);
+      used = 0;
+   }
+   fflush(fout);
+}
+
+void BinaryWriter::append(const void * data, size_t size){
+   if(used + size > buffer.size()){
+      fwrite(buffer.data(), 1, used, fout);
+      used = 0;
+   }
+   if(size > buffer.size()){//larger than the whole buffer, bypass it
+      fwrite(data, 1, size, fout);
+      return;
+   }
+   memcpy(buffer.data() + used, data, size);
+   used += size;
+}
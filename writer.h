@@ -0,0 +1,47 @@
+#ifndef _WRITER_H_
+#define _WRITER_H_
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+
+/**
+ * Binary container holding many cases in one file (little-endian int32 words):
+ *
+ * header: "LGEN" <version>
+ * record: <payload bytes> <payload>
+ * payload (see Layout::serialize):
+ *    case_id width height layers total_wl total_via
+ *    obs_num net_num pin_total via_total h_seg_total v_seg_total
+ *    obstacles[obs_num][6]
+ *    nets[net_num][6]: net_id wl pin_num via_num h_seg_num v_seg_num
+ *    pins[pin_total][3] vias[via_total][3] h_segs[h_seg_total][6] v_segs[v_seg_total][6]
+ *
+ * Records are appended in completion order, use case_id to identify them.
+ */
+#define BINARY_MAGIC "LGEN"
+#define BINARY_VERSION 1
+#define BINARY_HEADER_WORDS 12
+
+class BinaryWriter{
+public:
+   //resume: append to an existing container instead of overwriting it
+   BinaryWriter(const std::string & filename, size_t buffer_size = 1 << 20, bool resume = false);
+   ~BinaryWriter();
+
+   //case ids of the complete records of an existing container, cutting off a record left incomplete by a crash
+   static std::vector<int> recover(const std::string & filename);
+
+   void write(const std::vector<int32_t> & record);//thread safe
+   void flush();
+private:
+   void append(const void * data, size_t size);
+
+   std::mutex lock;
+   FILE * fout;
+   std::vector<char> buffer;
+   size_t used;
+};
+
+#endif